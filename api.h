@@ -21,4 +21,21 @@ Results FindWords(const char* board, unsigned width, unsigned height); // << TOD
 // `results` is identical to what was returned from `FindWords`
 void FreeWords(Results results); // << TODO
 
+// Not part of the assignment:
+
+// Offline step: loads the dictionary at `path` and writes it, flattened, to `imagePath` (only fit for the same build & thread count).
+// Returns false without loading anything if this build can't write images (LOUDS_TRIE).
+bool CompileDictionaryImage(const char* path, const char* imagePath);
+// Maps an image written by CompileDictionaryImage(); if it's missing, damaged or foreign it returns false, leaving an empty dictionary.
+bool LoadDictionaryImage(const char* imagePath);
+
+// Switches FindWords() and FindWordsBatch() from the dictionary trie (default) to a hash table of all prefixes (built right away, or along with the dictionary) and back; false if built without it.
+bool UsePrefixHash(bool use);
+
+// Picks what FindWords() matches neighbours with, by name ("none", "sse2", "avx2" or "avx512f"; nullptr for the widest this CPU runs, the default); false if built without SIMD_NEIGHBOURS or the CPU lacks it.
+bool UseNeighbourKernel(const char* name);
+
+// FindWords() for `count` boards at once, much cheaper per board (think thousands of small ones); each of `out` is to be freed with FreeWords().
+void FindWordsBatch(const char* const* boards, const unsigned* widths, const unsigned* heights, unsigned count, Results* out);
+
 #endif // API_H
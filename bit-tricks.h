@@ -1,6 +1,13 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+	#include <intrin.h>
+#endif
+
 #include "inline.h"
 
 BOGGLE_INLINE_FORCE unsigned RoundPow2_32(unsigned value)
@@ -43,4 +50,62 @@ BOGGLE_INLINE_FORCE unsigned GetNumBits(unsigned integer)
 	}
 
 	return bitCount;
-}
\ No newline at end of file
+}
+
+// Value must be non-zero.
+BOGGLE_INLINE_FORCE unsigned CountTrailingZeros64(uint64_t value)
+{
+#ifdef _WIN32
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return unsigned(index);
+#else
+	return unsigned(__builtin_ctzll(value));
+#endif
+}
+
+// Branchless (unlike GetNumBits()); a single instruction if the target has one.
+BOGGLE_INLINE_FORCE unsigned CountBits(uint32_t value)
+{
+#if defined(__POPCNT__)
+	return unsigned(__builtin_popcount(value));
+#elif defined(_WIN32) && defined(__AVX__)
+	return __popcnt(value);
+#else
+	value = value - ((value >> 1) & 0x55555555);
+	value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+	return (((value + (value >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+#endif
+}
+
+BOGGLE_INLINE_FORCE unsigned CountBits64(uint64_t value)
+{
+#if defined(__POPCNT__)
+	return unsigned(__builtin_popcountll(value));
+#elif defined(_WIN32) && defined(__AVX__)
+	return unsigned(__popcnt64(value));
+#else
+	return CountBits(uint32_t(value)) + CountBits(uint32_t(value >> 32));
+#endif
+}
+
+// Position of the (0-based) n-th set bit, which must be there: halves the search down to a byte, then strips bits.
+BOGGLE_INLINE_FORCE unsigned SelectBit64(uint64_t value, unsigned n)
+{
+	unsigned position = 0;
+	for (unsigned width = 32; width >= 8; width >>= 1)
+	{
+		const unsigned count = CountBits64(value & ((1ull << width)-1));
+		if (n >= count)
+		{
+			n -= count;
+			value >>= width;
+			position += width;
+		}
+	}
+
+	for (; 0 != n; --n)
+		value &= value-1;
+
+	return position + CountTrailingZeros64(value);
+}
@@ -0,0 +1,81 @@
+/*
+	Win32+GCC read-only file mapping.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef _WIN32
+
+	#include <windows.h>
+
+	// Returns nullptr on failure; the view keeps the mapping alive, so the handles can go right away.
+	__inline const void* mapFile(const char* path, size_t* size)
+	{
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (INVALID_HANDLE_VALUE == file)
+			return nullptr;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || 0 == fileSize.QuadPart)
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+
+		if (nullptr == mapping)
+			return nullptr;
+
+		const void* address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+
+		*size = size_t(fileSize.QuadPart);
+		return address;
+	}
+
+	__inline void unmapFile(const void* address, size_t size) { UnmapViewOfFile(address); }
+
+#elif defined(__GNUC__)
+
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+
+	// Returns nullptr on failure.
+	__inline const void* mapFile(const char* path, size_t* size)
+	{
+		const int file = open(path, O_RDONLY);
+		if (-1 == file)
+			return nullptr;
+
+		struct stat status;
+		if (-1 == fstat(file, &status) || 0 == status.st_size)
+		{
+			close(file);
+			return nullptr;
+		}
+
+	#if defined(MAP_POPULATE)
+		const int flags = MAP_PRIVATE|MAP_POPULATE; // Fault it all in right away (Linux)
+	#else
+		const int flags = MAP_PRIVATE;
+	#endif
+
+		void* address = mmap(nullptr, size_t(status.st_size), PROT_READ, flags, file, 0);
+		close(file);
+
+		if (MAP_FAILED == address)
+			return nullptr;
+
+		*size = size_t(status.st_size);
+		return address;
+	}
+
+	__inline void unmapFile(const void* address, size_t size) { munmap(const_cast<void*>(address), size); }
+
+#endif
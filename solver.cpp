@@ -9,6 +9,7 @@
 
 	To do (low priority):
 		- Building (or loading) my dictionary is slow(ish), I'm fine with that as I focus on the solver; or should I precalculate even more?
+		  + CompileDictionaryImage() writes it all (flattened) to disk once, LoadDictionaryImage() maps that back in milliseconds.
 
 	Notes:
 		- Currently tested on Windows 10 (VS2019), Linux & OSX.
@@ -27,13 +28,21 @@
 	Optimization ideas:
 	- That memcpy() taking 3% (of whatever) is nagging me -> WIP.
 	  + https://squadrick.dev/journal/going-faster-than-memcpy.html
-	- Copy() can be faster (analyze it).
 	- Prefetch instructions are a bitch to get right, streaming ones less so.
+	- Bounds checks on every step of TraverseBoard() add up.
+	  + Boards carry a border that always looks visited (kTileBorder), so it's 8 fixed offsets and no checks.
+	- The recursion depends on the compiler going along with BOGGLE_INLINE_FORCE; ITERATIVE_TRAVERSAL doesn't, but it's
+	  slower with GCC (15-30% on 100x100 and up), so it's off.
 	- Try 'reverse pruning' only to a certain degree (first test up to 3-letter words, then move up, maybe correlate it to an actual value (heuristic)). -> WIP
 
 	Things about the OpenMP version:
+	- Queries no longer use OpenMP but a persistent, pinned worker pool (worker-pool.h) that lives as long as the dictionary.
 	- Results are (FIXME) invalid as soon as a new dictionary is loaded!
 	- Problem: load is unbalanced in that *one* thread has a significantly higher load, you can see this in Superluminal when using correct number of threads.
+	  + WORK_STEALING lets idle workers take subtrees off the busy ones, so a query takes about the average load instead of the worst.
+	  + CALIBRATED_SHARDING balances the shards themselves on measured traversal cost (at the price of a slower LoadDictionary()).
+	- Very large boards (say 4096x4096) have every worker copy and scan all of it for it's shard; BOARD_PARTITIONING cuts them up instead,
+	  see LARGE_BOARD_BENCHMARK in 'test.cpp' to measure how that scales.
 */
 
 // Make VC++ 2015 shut up and walk in line.
@@ -54,8 +63,10 @@
 #include <mutex>
 #include <thread>
 #include <vector>
+#include <unordered_map>
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 
 #include <omp.h>
 
@@ -78,8 +89,10 @@
 #include "api.h"
 
 #include "random.h"
+#include "tinymt/tinymt32.h"
 #include "bit-tricks.h"
 #include "inline.h"
+#include "mapped-file.h"
 
 // Undef. to skip dead end percentages and all prints and such.
 // #define DEBUG_STATS
@@ -97,9 +110,166 @@
 // Set to 0 to use index of letter 'U' instead of extra 4 bytes
 #define USE_EXTRA_INDEX 0
 
+// Def. to traverse the shared (pristine) dictionary pools instead of a per-query copy; what would be mutated
+// is kept in a per-thread side table instead (see NodeState).
+// #define NON_DESTRUCTIVE_TRAVERSAL
+
+// Def. to split each query into (shard x two-letter prefix) tasks that idle workers steal from busy ones,
+// instead of every worker traversing just it's own shard.
+// #define WORK_STEALING
+
+// Def. to shard the dictionary by two-letter prefix, balanced on what they cost to traverse on a few random boards
+// (measured at load time, see CalibrateSharding()) instead of on word and node counts.
+// #define CALIBRATED_SHARDING
+#define CALIBRATION_BOARDS 8
+#define CALIBRATION_BOARD_SIZE 64
+
+// Def. to cut boards of BOARD_PARTITION_MIN_SIZE tiles or more into squares (plus a halo) that free workers pick up and
+// solve against the whole (shared) dictionary, instead of every worker taking on the whole board for it's shard.
+// Implies NON_DESTRUCTIVE_TRAVERSAL. On a single core it's slower (1024x1024: 1.42 s against 0.94 s, 4096x4096: 15.8 s
+// against 10.7 s, 16384x16384 not run). Experimental: held back until it's been measured from 1 to N cores on 1k, 4k
+// and 16k boards (see LARGE_BOARD_BENCHMARK in test.cpp), the only case it's meant to win.
+// #define BOARD_PARTITIONING
+#define BOARD_PARTITION_MIN_SIZE 1024*1024
+#define BOARD_PARTITION_SQUARE 256
+
+#if defined(BOARD_PARTITIONING) && !defined(NON_DESTRUCTIVE_TRAVERSAL)
+	#define NON_DESTRUCTIVE_TRAVERSAL
+#endif
+
+// Def. to count the letters on each board first, so that shards that can't start a single word are skipped (dictionary
+// copy and all) and subtrees that need a letter the board has no unvisited tiles of left aren't entered.
+// #define LETTER_HISTOGRAM
+
+// Def. to find out which letters are next to which on each board first, so that TraverseBoard() doesn't look around for
+// letters that can't follow anywhere. Switches itself off (per query) once more than BIGRAM_MASK_MAX_DENSITY percent
+// of the letter pairs turn up, as it won't prune a thing (large boards), and says so with debug_print().
+// #define BIGRAM_MASK
+#define BIGRAM_MASK_MAX_DENSITY 90
+
+// Def. to keep, per tile, the letters next to it (computed right after sanitizing, see GetNeighbourMasks()), so
+// TraverseBoard() can tell if any of what may follow is around with a single AND; not for boards over
+// NEIGHBOUR_MASKS_MAX_SIZE tiles (4 bytes each). Costs 30-75 us per query on 100x100, 3-5 ms on 1000x1000 (under 1% of
+// the query). Faster with NON_DESTRUCTIVE_TRAVERSAL (4x4: 18.4 -> 16.8 us, sparse 10x10: 958 -> 852 us, 100x100: 20.3
+// -> 18.8 ms), but slower on large boards in copy mode (100x100: 21.8 -> 25.0 ms).
+// #define NEIGHBOUR_MASKS
+#define NEIGHBOUR_MASKS_MAX_SIZE 4096*4096
+
+// Def. to have TraverseBoard() find the neighbours that are unvisited and may follow in one go and only look at those.
+// There's an SSE2, AVX2 and AVX-512 version, whatever the build targets; the widest the CPU has is picked at startup
+// (see UseNeighbourKernel()). Recursive traversal only.
+// #define SIMD_NEIGHBOURS
+
+// Def. to have ExecuteThread(), for boards of RELAXED_PREFILTER_MIN_SIZE tiles or more, first take out every branch of
+// the shard that can't lead to a word even if tiles could be used more than once (see Query::Prefilter()), so that
+// the traversal doesn't have to run into each of those dead ends one path at a time. It prunes a lot (100x100: the
+// traversal after it takes 6.5 instead of 14 ms), but the pass itself costs more than that, as nearly every prefix
+// survives the relaxation down to a fair depth: slower at every size (64x64: 8.1 -> 10.5 ms, 100x100: 15.4 -> 21.1 ms,
+// 200x200: 49.8 -> 84.9 ms).
+// #define RELAXED_PREFILTER
+#define RELAXED_PREFILTER_MIN_SIZE 64*64
+
+// Def. to shrink DictionaryNode from 128 bytes (a slot per letter) to 32: a node only knows where it's children (side
+// by side) start and picks one by counting the letter bits below it's own. A quarter of the memory and a smaller copy
+// per query (100x100: 23.3 -> 17.1 ms); it's L2 miss rate hasn't been measured.
+// #define COMPACT_NODES
+
+// Def. to move what's rarely read (DictionaryNode::GetRequiredLetters()) out of the (compact) nodes into an array of
+// it's own that's never copied, which gets them down to 16 bytes (the pool base to index it with is a ThreadContext
+// member). Faster in copy mode (100x100: 17.6 -> 14.0 ms), but slower with NON_DESTRUCTIVE_TRAVERSAL (17.7 -> 20.2 ms).
+// #define HOT_COLD_NODES
+
+#if defined(HOT_COLD_NODES) && !defined(COMPACT_NODES)
+	#error "HOT_COLD_NODES requires COMPACT_NODES."
+#endif
+
+// Def. to start each traversal at the second letter (so a tile and a neighbour) straight from a table of nodes per
+// two-letter prefix, instead of going through the root and first level every time.
+// #define PREFIX_TABLE
+
+// Def. to have TraverseBoard() follow chains of nodes with a single child and no word (see s_chains) by letter, up to
+// RADIX_CHAIN_LENGTH at once, instead of node by node. Recursive traversal only, requires COMPACT_NODES. Faster with
+// NON_DESTRUCTIVE_TRAVERSAL (10x10: 894 -> 794 us, 100x100: 16.2 -> 16.0 ms) and on small boards in copy mode (4x4:
+// 608 -> 490 us), but slower on large ones there (100x100: 13.4 -> 16.0 ms), as reading s_chains costs on every node.
+// #define RADIX_CHAINS
+#define RADIX_CHAIN_LENGTH 5
+
+#if defined(RADIX_CHAINS) && !defined(COMPACT_NODES)
+	#error "RADIX_CHAINS requires COMPACT_NODES."
+#endif
+
+// Def. to keep a table of grandchildren by two letters for nodes (down to GRANDCHILD_MAX_DEPTH) with at least
+// GRANDCHILD_MIN_CHILDREN children, so that TraverseBoard() can prefetch those around it before it goes down. Costs
+// 2.4MB (tables and index, dictionary.txt); faster with NON_DESTRUCTIVE_TRAVERSAL (100x100: 19.6 -> 17.8 ms, 10x10:
+// 973 -> 921 us), about even in copy mode (100x100: 12.9 -> 12.6 ms). 12 children profiled best (of 6, 12 and 18).
+// #define GRANDCHILD_TABLES
+#define GRANDCHILD_MIN_CHILDREN 12
+#define GRANDCHILD_MAX_DEPTH 3
+
+// Arrays that go along with the nodes of all pools, see ThreadContext::SetNodes().
+#if defined(HOT_COLD_NODES) || defined(RADIX_CHAINS) || defined(GRANDCHILD_TABLES)
+	#define NODE_SIDE_TABLES
+#endif
+
+// Something to find out about a board's letters before traversing it, see BoardLetters.
+#if defined(LETTER_HISTOGRAM) || defined(BIGRAM_MASK)
+	#define BOARD_LETTERS
+#endif
+
+// Def. to traverse a double-array trie per shard instead (see BuildDoubleArray()): 8 bytes a state, a transition
+// being an add and a compare, and a bitset per thread of states with nothing left to find rather than RemoveChild().
+// Leaves the node pools (and everything that goes with them, such as LETTER_HISTOGRAM) out of the query altogether.
+// #define DOUBLE_ARRAY_TRIE
+
+#if defined(DOUBLE_ARRAY_TRIE) && (defined(WORK_STEALING) || defined(BOARD_PARTITIONING))
+	#error "DOUBLE_ARRAY_TRIE can't be combined with WORK_STEALING or BOARD_PARTITIONING."
+#endif
+
+// Def. to traverse a minimized DAWG per shard instead (see BuildDawg()): shared suffixes are stored once, so a node
+// can't hold a word index any more; instead a path adds up to the word's rank in the shard (by way of word counts),
+// which a table maps to it's index. Found words go in a bitset per thread, and as a node's words are a range of
+// ranks, it can tell when they've all been found (given no more than 64 of them).
+// #define DAWG_DICTIONARY
+
+#if defined(DAWG_DICTIONARY) && (defined(WORK_STEALING) || defined(BOARD_PARTITIONING) || defined(DOUBLE_ARRAY_TRIE))
+	#error "DAWG_DICTIONARY can't be combined with WORK_STEALING, BOARD_PARTITIONING or DOUBLE_ARRAY_TRIE."
+#endif
+
+// Def. to traverse a LOUDS trie per shard instead (see BuildLouds()): the shape of the trie in 2 bits a node plus a letter
+// a node, with rank and select to go from a node to it's children, read by all threads at once. Found and dead nodes go
+// in bitsets per thread. Once built the node pools are let go of (unless mapped, see LoadDictionaryImage()) and the
+// global pool is down to LOUDS_GLOBAL_POOL_SIZE. Meant for when memory is tight: dictionary.txt fits in under 1.5MB
+// (word indices included), but large boards take about 3 times as long (small ones are faster, as there's no pool to copy).
+// #define LOUDS_TRIE
+#define LOUDS_GLOBAL_POOL_SIZE 1024*1024*64 // Holds the sanitized board(s): up to about 8000x8000 (a fifth with NEIGHBOUR_MASKS).
+
+#if defined(LOUDS_TRIE) && (defined(NON_DESTRUCTIVE_TRAVERSAL) || defined(WORK_STEALING) || defined(DOUBLE_ARRAY_TRIE) || defined(DAWG_DICTIONARY))
+	#error "LOUDS_TRIE can't be combined with NON_DESTRUCTIVE_TRAVERSAL (or BOARD_PARTITIONING), WORK_STEALING, DOUBLE_ARRAY_TRIE or DAWG_DICTIONARY."
+#endif
+
+// Def. to build in the prefix hash engine, which UsePrefixHash() switches queries to (and back) at runtime: every prefix
+// of the dictionary in an open-addressing table of cache line sized buckets (see PrefixHash), found by hashing the slot
+// of the prefix a letter shorter along with that letter. So instead of following a pointer, each step is a probe of
+// it's own, and those for all 8 neighbours can be fetched before looking at any. Without it, UsePrefixHash() returns false.
+// #define PREFIX_HASH_ENGINE
+
+#if defined(PREFIX_HASH_ENGINE) && (defined(WORK_STEALING) || defined(BOARD_PARTITIONING) || defined(DOUBLE_ARRAY_TRIE) || defined(DAWG_DICTIONARY) || defined(LOUDS_TRIE))
+	#error "PREFIX_HASH_ENGINE can't be combined with WORK_STEALING, BOARD_PARTITIONING, DOUBLE_ARRAY_TRIE, DAWG_DICTIONARY or LOUDS_TRIE."
+#endif
+
+// Def. to have TraverseBoard() walk the board with an explicit (fixed-size) stack instead of recursing,
+// so we don't depend on what the compiler makes of BOGGLE_INLINE_FORCE.
+// #define ITERATIVE_TRAVERSAL
+
 // static thread_local unsigned s_iThread;       // Dep. for thread heaps.
-#define GLOBAL_MEMORY_POOL_SIZE 1024*1024*2000   // Just allocate as much as we can in 1 go.
+#if defined(LOUDS_TRIE)
+	#define GLOBAL_MEMORY_POOL_SIZE LOUDS_GLOBAL_POOL_SIZE
+#else
+	#define GLOBAL_MEMORY_POOL_SIZE 1024*1024*2000   // Just allocate as much as we can in 1 go.
+#endif
 #include "custom-allocator.h"                    // Depends on Ned Flanders & co. :)
+#include "worker-pool.h"                         // Depends on FOR_INTEL & co.
+#include "work-stealing.h"
 
 constexpr size_t kAlignTo = 16; // 128-bit
 
@@ -132,7 +302,8 @@ constexpr size_t kAlignTo = 16; // 128-bit
 	__inline void debug_print(const char* format, ...) {}
 #endif
 
-const size_t kNumConcurrrency = std::thread::hardware_concurrency();
+// CPUs we may actually use (affinity mask, so cpusets are respected), as opposed to std::thread::hardware_concurrency().
+const size_t kNumConcurrrency = GetAvailableCPUs().size();
 
 // Yup, this sucks, but the load isn't balanced correctly (FIXME).
 #if defined(FOR_INTEL)
@@ -171,11 +342,12 @@ BOGGLE_INLINE_FORCE static void ClosePrefetch(const char* address)  {}
 class Word
 {
 public:
-	Word(unsigned score, const std::string& word) :
+	Word(unsigned score, const char* word, size_t length) :
 	score(score)
-//,	word(word)
+,	word{} // No garbage past the terminator (dictionary image)
 	{
-		strcpy(this->word, word.c_str());
+		memcpy(this->word, word, length);
+		this->word[length] = 0;
 	}
 	
 	size_t score;
@@ -201,11 +373,26 @@ static std::vector<ThreadInfo> s_threadInfo;
 // Full dictionary
 static std::vector<Word> s_words;
 
+// What the solver reads words from: either s_words or a mapped dictionary image.
+static const Word* s_wordTable = nullptr;
+
 constexpr unsigned kAlphaRange = ('Z'-'A')+1;
 
 // Cheap way to tag along the tiles (few bits left)
 constexpr unsigned kTileVisitedBit = 1<<7;
 
+// Neighbouring tiles (X, Y), in the order TraverseBoard() visits them.
+constexpr int kNeighbours[8][2] = { { 1, -1 }, { 0, -1 }, { -1, -1 }, { -1, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 } };
+
+// Boards are kept with a 1-tile border of these all around: it looks visited for good, so a traversal never steps
+// off the board and needs no bounds checks. Tile (X, Y) lives at (Y+1)*(width+2) + X+1.
+constexpr char kTileBorder = char(kTileVisitedBit);
+
+BOGGLE_INLINE_FORCE static size_t GetPaddedGridSize(unsigned width, unsigned height)
+{
+	return size_t(width+2)*(height+2);
+}
+
 // If you see 'letter' and 'index' used: all it means is that an index is 0-based.
 BOGGLE_INLINE_FORCE unsigned LetterToIndex(unsigned letter)
 {
@@ -224,15 +411,24 @@ constexpr auto kIndexU = 'U'-'A'; // LetterToIndex('U');
 class LoadDictionaryNode;
 class DictionaryNode;
 
-// A tree root per thread.
+// A tree root per thread (only while loading).
 static std::vector<LoadDictionaryNode*> s_threadDicts;
 
+// Flattened (pristine) pool per thread, copied by every query; lives in s_poolStorage or a mapped image.
+static std::vector<const DictionaryNode*> s_threadPools;
+static DictionaryNode* s_poolStorage = nullptr;
+
+#if defined(HOT_COLD_NODES)
+// DictionaryNode::GetRequiredLetters(), per node of all pools (which are back to back), right after the last one.
+static const uint32_t* s_requiredLetters = nullptr;
+#endif
+
 // Load node.
 class LoadDictionaryNode
 {
 	friend class DictionaryNode;
 
-	friend void AddWordToDictionary(const std::string& word, size_t iThread);
+	friend void AddWordToTree(LoadDictionaryNode* node, const char* word, unsigned length, int32_t wordIdx, size_t iThread);
 	friend void FreeDictionary();
 
 public:
@@ -297,17 +493,14 @@ public:
 	class ThreadCopy
 	{
 	public:
-		ThreadCopy(unsigned iThread)
+		ThreadCopy(unsigned iThread) :
+			m_iThread(iThread)
 		{
 			const auto size = s_threadInfo[iThread].nodes*sizeof(DictionaryNode);
 			m_pool = static_cast<DictionaryNode*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(size, kAlignTo));
 
-			// Recursively copy them.
-			Copy(s_threadDicts[iThread]);
-
-#if _DEBUG
-			m_pool->m_children[kIndexParent] = 0xcdcdcdcd;
-#endif
+			// Flattened at load time and position independent, so all it takes is a bulk copy.
+			CopyPool(m_pool, s_threadPools[iThread], s_threadInfo[iThread].nodes);
 		}
 
 		~ThreadCopy() {};
@@ -317,46 +510,146 @@ public:
 			return m_pool;
 		}
 
-	private:
-		BOGGLE_INLINE_FORCE uint32_t Copy(LoadDictionaryNode* parent)
+		// Undoes a query given every node it changed (duplicates are fine), or just copies it all again if that's cheaper.
+		void Restore(DictionaryNode* const* changed, size_t numChanged)
 		{
-			DictionaryNode* node = m_pool + m_iAlloc++;
+			const DictionaryNode* pristine = s_threadPools[m_iThread];
+			const size_t numNodes = s_threadInfo[m_iThread].nodes;
+
+			// A scattered restore touches a line per node, a copy streams 2 of them per node.
+			if (numChanged > numNodes/4)
+			{
+				CopyPool(m_pool, pristine, numNodes);
+				return;
+			}
+
+			for (size_t iChanged = 0; iChanged < numChanged; ++iChanged)
+			{
+				DictionaryNode* node = changed[iChanged];
+				const DictionaryNode& original = pristine[node-m_pool];
 
-			unsigned indexBits = node->m_indexBits = parent->m_indexBits;
-			node->m_wordIdx = parent->m_wordIdx;
+				node->m_indexBits = original.m_indexBits;
+				node->m_wordIdx = original.m_wordIdx;
+			}
+		}
 
-			// Yes, you're seeing this correctly, we're chopping a 64-bit pointer in half.
-			// Quite volatile, but usually works out fine.
-			node->m_poolUpper32 = reinterpret_cast<uint64_t>(m_pool) & 0xffffffff00000000;
+	private:
+		BOGGLE_INLINE static void CopyPool(DictionaryNode* destination, const DictionaryNode* source, size_t numNodes)
+		{
+#if defined(STREAM_WRITES)
+			// Destination is (at least) 16-byte aligned, source is aligned to a node.
+			static_assert(0 == sizeof(DictionaryNode) % sizeof(__m128i));
 
-			const uint32_t nodeLower32 = reinterpret_cast<intptr_t>(node) & 0xffffffff;
+			const __m128i* read = reinterpret_cast<const __m128i*>(source);
+			__m128i* write = reinterpret_cast<__m128i*>(destination);
+			const __m128i* end = reinterpret_cast<const __m128i*>(source + numNodes);
 
-//			if (indexBits > 0)
+			for (; read+4 <= end; read += 4, write += 4)
 			{
+				const __m128i A = _mm_load_si128(read+0), B = _mm_load_si128(read+1), C = _mm_load_si128(read+2), D = _mm_load_si128(read+3);
+				_mm_stream_si128(write+0, A);
+				_mm_stream_si128(write+1, B);
+				_mm_stream_si128(write+2, C);
+				_mm_stream_si128(write+3, D);
+			}
+
+			// Odd number of (small) nodes?
+			for (; read < end; ++read, ++write)
+				_mm_stream_si128(write, _mm_load_si128(read));
+
+			_mm_sfence();
+#else
+			memcpy(destination, source, numNodes*sizeof(DictionaryNode));
+#endif
+		}
+
+		const unsigned m_iThread;
+		DictionaryNode* m_pool;
+	};
+
+#if defined(COMPACT_NODES)
+	// Lays a load tree out from 'next' onwards (which it advances): each node's children side by side, each followed
+	// by their own subtrees. Children are stored relative to their parent, so the result can be copied or mapped
+	// anywhere as-is. With HOT_COLD_NODES, what GetRequiredLetters() would say goes to 'requiredLetters' (if any),
+	// by index from the root.
+	static DictionaryNode* Flatten(DictionaryNode*& next, LoadDictionaryNode* parent, uint32_t* requiredLetters = nullptr)
+	{
+		DictionaryNode* node = next++;
+		FlattenInto(node, next, parent, node, requiredLetters);
+		return node;
+	}
+
+private:
+	// Returns the letters required (see GetRequiredLetters()).
+	static uint32_t FlattenInto(DictionaryNode* node, DictionaryNode*& next, LoadDictionaryNode* parent, const DictionaryNode* root, uint32_t* requiredLetters)
+	{
+		unsigned indexBits = node->m_indexBits = node->m_childBits = parent->m_indexBits;
+		node->m_wordIdx = parent->m_wordIdx;
+
+		// Nothing's required if there's a word right here, otherwise it's whatever all children agree on.
+		uint32_t required = (node->HasWord() || 0 == indexBits) ? 0 : ~0u;
+
+		DictionaryNode* child = next;
+		next += CountBits(indexBits);
+		node->m_firstChild = uint32_t(reinterpret_cast<const char*>(child) - reinterpret_cast<const char*>(node));
+
+		for (; 0 != indexBits; indexBits &= indexBits-1, ++child)
+		{
+			const unsigned index = CountTrailingZeros64(indexBits);
+			required &= (1u << index) | FlattenInto(child, next, parent->GetChild(index), root, requiredLetters);
+		}
+
+#if defined(HOT_COLD_NODES)
+		if (nullptr != requiredLetters)
+			requiredLetters[node-root] = required;
+#else
+		node->m_requiredLetters = required;
+#endif
+
+		return required;
+	}
+#else
+	// Lays a load tree out depth-first from 'next' onwards (which it advances); children are stored relative
+	// to their parent, so the result can be copied or mapped anywhere as-is.
+	static DictionaryNode* Flatten(DictionaryNode*& next, LoadDictionaryNode* parent)
+	{
+		DictionaryNode* node = next++;
+
+		unsigned indexBits = node->m_indexBits = parent->m_indexBits;
+		node->m_wordIdx = parent->m_wordIdx;
+
+		// Nothing's required if there's a word right here, otherwise it's whatever all children agree on.
+		uint32_t requiredLetters = (node->HasWord() || 0 == indexBits) ? 0 : ~0u;
+
+//		if (indexBits > 0)
+		{
 #ifdef _WIN32
-				unsigned long index;
-				if (_BitScanForward(&index, indexBits))
-				{
+			unsigned long index;
+			if (_BitScanForward(&index, indexBits))
+			{
 #elif defined(__GNUC__)
-				int index = __builtin_ffs(int(indexBits));
-				if (index--)
-				{
+			int index = __builtin_ffs(int(indexBits));
+			if (index--)
+			{
 #endif
-					for (indexBits >>= index; index < kAlphaRange+USE_EXTRA_INDEX; ++index, indexBits >>= 1)
+				for (indexBits >>= index; index < kAlphaRange+USE_EXTRA_INDEX; ++index, indexBits >>= 1)
+				{
+					if (indexBits & 1)
 					{
-						if (indexBits & 1)
-							node->m_children[index] = Copy(parent->GetChild(index));
+						const DictionaryNode* child = Flatten(next, parent->GetChild(index));
+						node->m_children[index] = uint32_t(reinterpret_cast<const char*>(child) - reinterpret_cast<const char*>(node));
+
+						requiredLetters &= (1u << index) | child->m_requiredLetters;
 					}
 				}
 			}
-
-			return nodeLower32;
 		}
 
-	private:
-		DictionaryNode* m_pool;
-		size_t m_iAlloc = 0;
-	};
+		node->m_requiredLetters = requiredLetters;
+
+		return node;
+	}
+#endif
 
 	// Destructor is not called when using ThreadCopy!
 	~DictionaryNode() = delete;
@@ -418,7 +711,7 @@ public:
 		Assert(HasChild(index));
 #endif
 
-		return reinterpret_cast<DictionaryNode*>(m_poolUpper32|m_children[index]);
+		return reinterpret_cast<DictionaryNode*>(reinterpret_cast<uintptr_t>(this) + GetChildOffset(index));
 	}
 
 	// Returns NULL if no child.
@@ -428,7 +721,7 @@ public:
 			return nullptr;
 		else
 		{
-			return reinterpret_cast<DictionaryNode*>(m_poolUpper32|m_children[index]); // This dirty trick courtesty of Alex B.
+			return reinterpret_cast<DictionaryNode*>(reinterpret_cast<uintptr_t>(this) + GetChildOffset(index));
 		}
 	}
 
@@ -443,531 +736,5132 @@ public:
 		m_wordIdx = -1;
 	}
 
+#if !defined(HOT_COLD_NODES)
+	// Letters (bits, like HasChildren()) that every word further down needs, no matter which way it's spelled.
+	BOGGLE_INLINE_FORCE uint32_t GetRequiredLetters() const
+	{
+		return m_requiredLetters;
+	}
+#endif
+
 private:
+	BOGGLE_INLINE_FORCE uint32_t GetChildOffset(unsigned index) const
+	{
+#if defined(COMPACT_NODES)
+		return m_firstChild + CountBits(m_childBits & ((1u << index)-1))*uint32_t(sizeof(DictionaryNode));
+#else
+		return m_children[index];
+#endif
+	}
+
 	uint32_t m_indexBits;
-	uint64_t m_poolUpper32;
-	uint32_t m_children[kAlphaRange+USE_EXTRA_INDEX];
-	int32_t m_wordIdx; // Sits on a 16-byte boundary
+	int32_t m_wordIdx; // Read on every visit, so it sits with m_indexBits
+#if !defined(HOT_COLD_NODES)
+	uint32_t m_requiredLetters; // Never changes, so no need to restore it (see ThreadCopy::Restore())
+#endif
+#if defined(COMPACT_NODES)
+	uint32_t m_childBits;  // What 'm_indexBits' started out as, so (unlike it) always good to count children with
+	uint32_t m_firstChild; // Offset (in bytes) from this node, always positive
+#if !defined(HOT_COLD_NODES)
+	uint32_t m_padding[3];
+#endif
+#else
+	uint32_t m_children[kAlphaRange+USE_EXTRA_INDEX]; // Offset (in bytes) from this node, always positive
+	uint32_t m_padding[(128/sizeof(uint32_t)) - (3+kAlphaRange+USE_EXTRA_INDEX)];
+#endif
 };
 
-// Keep the above exactly 128 bytes, keep it that way!
-static_assert(sizeof(DictionaryNode) == 128);
+// Keep the above exactly 128 (or 32, or 16) bytes, keep it that way!
+#if defined(HOT_COLD_NODES)
+	static_assert(sizeof(DictionaryNode) == 16);
+	static_assert(0 == USE_EXTRA_INDEX);
+#elif defined(COMPACT_NODES)
+	static_assert(sizeof(DictionaryNode) == 32);
+	static_assert(0 == USE_EXTRA_INDEX); // The parent 'child' isn't there
+#else
+	static_assert(sizeof(DictionaryNode) == 128);
+#endif
 
-// We keep one dictionary at a time so it's access is protected by a mutex, just to be safe.
-static std::mutex s_dictMutex;
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
 
-// Counters, the latter being useful to reserve space.
-static unsigned s_longestWord;
-static size_t s_wordCount;
+// What a query would otherwise mutate in a (copied) DictionaryNode, by node index, per thread.
+// Only valid if 'epoch' matches that of the current query; if not, it's (re)initialized from the node on first touch,
+// so nothing needs to be copied or reset between queries.
+class NodeState
+{
+public:
+	uint32_t epoch;
+	uint32_t indexBits; // Or kWordFoundBit once the node's word has been found
+};
 
-BOGGLE_INLINE static unsigned GetWordScore_Readable(size_t length) /* const */
+constexpr uint32_t kWordFoundBit = 1u<<31;
+static_assert(kAlphaRange+USE_EXTRA_INDEX < 31);
+
+static std::vector<NodeState*> s_threadStates;
+static std::vector<uint32_t> s_threadEpochs;
+static NodeState* s_stateStorage = nullptr;
+
+// Call once the pools are in place.
+static void AllocateNodeStates()
 {
-	length -= 3;
-	length = length > 5 ? 5 : length; // This nicely compiles to a conditional move
+	size_t numNodes = 0;
+	for (const auto& info : s_threadInfo)
+		numNodes += info.nodes;
 
-	constexpr unsigned kLUT[] = { 1, 1, 2, 3, 5, 11 };
-	return kLUT[length];
+	// Epoch 0 is never used, so this invalidates all of them.
+	s_stateStorage = static_cast<NodeState*>(mallocAligned(numNodes*sizeof(NodeState), kPageSize));
+	memset(s_stateStorage, 0, numNodes*sizeof(NodeState));
+
+	NodeState* states = s_stateStorage;
+	for (const auto& info : s_threadInfo)
+	{
+		s_threadStates.push_back(states);
+		states += info.nodes;
+	}
+
+	s_threadEpochs.assign(kNumThreads, 0);
 }
 
-BOGGLE_INLINE static uint8_t GetWordScore_Albert(size_t length) /* const */
+// Call before each query (per thread).
+BOGGLE_INLINE static uint32_t NextEpoch(unsigned iThread)
 {
-	length = length > 8 ? 8 : length;
+	if (0 == ++s_threadEpochs[iThread])
+	{
+		// Wrapped around: this happens once every 4 billion queries, so just wipe them.
+		memset(s_threadStates[iThread], 0, s_threadInfo[iThread].nodes*sizeof(NodeState));
+		s_threadEpochs[iThread] = 1;
+	}
 
-	// Courtesy of Albert Sandberg, the bit magician.
-	size_t Albert = 0;
-	Albert += (length-3)>>1;
-	Albert += (length+10)>>4;
-	Albert += (length+9)>>4;
-	Albert += length<<2>>5<<2;
-	Albert += length<<2>>5<<1;
-	return uint8_t(Albert+1);
+	return s_threadEpochs[iThread];
 }
 
-#ifdef NED_FLANDERS
-// Scoped lock for all dictionary globals.
-class DictionaryLock
-{
-public:
-	DictionaryLock() :
-		m_lock(s_dictMutex) {}
-private:
-	std::lock_guard<std::mutex> m_lock;
-};
-#endif // NED_FLANDERS
+#if defined(BOARD_PARTITIONING)
 
-// Tells us if a word adheres to the rules.
-static bool IsWordValid(const std::string& word)
+// Same, but for all nodes (of all threads) per worker, for when any worker may traverse any shard.
+// Allocated by each worker on first use; all pools are contiguous, so a node's index is relative to the first one.
+static std::vector<NodeState*> s_workerStates;
+static std::vector<uint32_t> s_workerEpochs;
+
+// Only to be called by the worker itself.
+static uint32_t NextWorkerEpoch(unsigned iWorker)
 {
-	const size_t length = word.length();
+	size_t numNodes = 0;
+	for (const auto& info : s_threadInfo)
+		numNodes += info.nodes;
 
-	// Word not too short?
-	if (length < 3 || length > MAX_WORD_LEN)
+	if (nullptr == s_workerStates[iWorker])
 	{
-		debug_print("Invalid word because it's got less than 3 or more than %u letters: %s\n", MAX_WORD_LEN, word.c_str());
-		return false;
+		s_workerStates[iWorker] = static_cast<NodeState*>(mallocAligned(numNodes*sizeof(NodeState), kPageSize));
+		memset(s_workerStates[iWorker], 0, numNodes*sizeof(NodeState));
 	}
 
-	// Check if it violates the 'Qu' rule.
-	std::string mutWord = word;
-	auto iQ = mutWord.find_first_of('Q');
-	while (std::string::npos != iQ)
+	if (0 == ++s_workerEpochs[iWorker])
 	{
-		auto next = iQ+1;
-		if (next == length || mutWord[next] != 'U')
-		{
-			debug_print("Invalid word due to 'Qu' rule: %s\n", word.c_str());
-			return false;
-		}
-
-		mutWord = mutWord.substr(next);
-		iQ = mutWord.find_first_of('Q');
+		memset(s_workerStates[iWorker], 0, numNodes*sizeof(NodeState));
+		s_workerEpochs[iWorker] = 1;
 	}
 
-	return true;
+	return s_workerEpochs[iWorker];
 }
 
-// Input word must be uppercase!
-/* static */ void AddWordToDictionary(const std::string& word, size_t iThread)
+#endif // BOARD_PARTITIONING
+
+#endif // NON_DESTRUCTIVE_TRAVERSAL
+
+#if defined(WORK_STEALING) || defined(CALIBRATED_SHARDING)
+
+static uint32_t CountNodes(const DictionaryNode* node)
 {
-	// Word of any use given the Boggle rules?	
-	if (false == IsWordValid(word))
-		return;
-	
-	const unsigned length = unsigned(word.length());
-	if (length > s_longestWord)
+	uint32_t count = 1;
+	for (unsigned index = USE_EXTRA_INDEX; index < kAlphaRange+USE_EXTRA_INDEX; ++index)
 	{
-		s_longestWord = length;
+		if (node->HasChild(index))
+			count += CountNodes(node->GetChild(index));
 	}
 
-	LoadDictionaryNode* node = s_threadDicts[iThread];
-	Assert(nullptr != node);
+	return count;
+}
 
-	for (auto iLetter = word.begin(); iLetter != word.end(); ++iLetter)
-	{
-		const char letter = *iLetter;
+#endif
 
-		// Get or create child node.
-		node = node->AddChild(letter, iThread);
+// Queries are executed by these, one worker per thread (dictionary shard), each with a heap and result list that persist across queries.
+static std::unique_ptr<WorkerPool> s_workerPool;
+static std::vector<size_t> s_threadHeapSizes;
+static std::vector<std::vector<unsigned>> s_threadWordsFound;
 
-		// Handle 'Qu' rule.
-		if ('Q' == letter)
-		{
-			// Verified to be 'Qu' by IsWordValid().
-			// Skip over 'U'.
-			++iLetter;
-		}
-	}
+#if defined(WORK_STEALING)
 
-	// Store word in dictionary (FIXME: less ham-fisted please).
-	s_words.emplace_back(Word(GetWordScore_Albert(length), word));
+// A two-letter prefix subtree of one shard, traversed from every tile holding the first letter.
+// Subtrees never overlap, so whichever worker runs it is the only one touching those nodes (or their state).
+class Task
+{
+public:
+	uint32_t cost; // Estimate: subtree nodes times tiles to start from
+	uint16_t iThread;
+	uint8_t first, second;
+};
 
-	// Store index in node.
-	node->m_wordIdx = int(s_wordCount);
+// Task indices, one deque per worker, initially holding the tasks of it's own shard.
+static std::unique_ptr<WorkStealingDeque<uint32_t>[]> s_threadDeques;
 
-	++s_threadInfo[iThread].load;
-	++s_wordCount;
-}
+// Number of nodes below each two-letter prefix, per shard (kAlphaRange*kAlphaRange each).
+static std::vector<uint32_t> s_prefixNodes;
 
-void LoadDictionary(const char* path)
+static void CountPrefixNodes()
 {
-	// If the dictionary fails to load, you'll be left with an empty dictionary.
-	FreeDictionary();
-	
-	if (nullptr == path)
-		return;
+	s_prefixNodes.assign(kNumThreads*kAlphaRange*kAlphaRange, 0);
 
-	FILE* file = fopen(path, "r");
-	if (nullptr == file)
+	for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
 	{
-		debug_print("Can not open dictionary for read access at: %s\n", path);
-		return;
+		const DictionaryNode* root = s_threadPools[iThread];
+		uint32_t* counts = &s_prefixNodes[iThread*kAlphaRange*kAlphaRange];
+
+		for (unsigned first = USE_EXTRA_INDEX; first < kAlphaRange+USE_EXTRA_INDEX; ++first)
+		{
+			if (!root->HasChild(first))
+				continue;
+
+			const DictionaryNode* child = root->GetChild(first);
+			for (unsigned second = USE_EXTRA_INDEX; second < kAlphaRange+USE_EXTRA_INDEX; ++second)
+			{
+				if (child->HasChild(second))
+					counts[(first-USE_EXTRA_INDEX)*kAlphaRange + second-USE_EXTRA_INDEX] = CountNodes(child->GetChild(second));
+			}
+		}
 	}
+}
 
-#ifdef NED_FLANDERS
-	DictionaryLock lock;
-#endif
+// Returns false if there's nothing left to steal (tasks aren't added during a query, so that's final).
+static bool StealTask(unsigned iWorker, uint32_t& iTask)
+{
+	for (;;)
 	{
-		for (auto iThread = 0; iThread < kNumThreads; ++iThread)
-			s_threadDicts.push_back(new LoadDictionaryNode()); // Allocated in AddWordToDictionary() for (ever so slightly) better locality
+		bool lostRace = false;
 
-		int character;
-		std::string word;
-		std::vector<std::string> words;
-	
-		do
+		// Start with the next worker over, so not everybody goes for the same victim.
+		for (unsigned iVictim = 1; iVictim < kNumThreads; ++iVictim)
 		{
-			character = fgetc(file);
-			if (0 != isalpha((unsigned char) character))
-			{
-				// Boggle tiles are simply A-Z, where Q means 'Qu'.
-				word += toupper(character);
-			}
-			else
-			{
-				// We've hit EOF or a non-alphanumeric character.
-				if (false == word.empty()) // Got a word?
-				{
-					words.push_back(word); 
-					word.clear();
-				}
-			}
+			const auto steal = s_threadDeques[(iWorker+iVictim) % kNumThreads].TrySteal(iTask);
+			if (WorkStealingDeque<uint32_t>::Steal::kSuccess == steal)
+				return true;
+
+			lostRace |= WorkStealingDeque<uint32_t>::Steal::kLostRace == steal;
 		}
-		while (EOF != character);
 
-		fclose(file);
+		if (false == lostRace)
+			return false;
 
-		// Pathetic attempt at load balancing:
-		const size_t numWords = words.size();
-		size_t wordsPerThread = numWords/kNumThreads;
-		Assert(0 == numWords % kNumThreads);
-		const unsigned maxNumRoots = unsigned(std::ceil(std::log2(kNumThreads)));
+		CpuRelax();
+	}
+}
 
-		unsigned iThread = 0;
-		for (const auto &word : words)
-		{
-			AddWordToDictionary(word, iThread);
+#endif // WORK_STEALING
 
-			const unsigned load = unsigned(s_threadInfo[iThread].load);
-			if (load >= wordsPerThread)
-			{
-				const size_t nodes = s_threadInfo[iThread].nodes;
+#if defined(RADIX_CHAINS)
 
-				unsigned curComp = unsigned(nodes)/(1+load);
-				for (unsigned iComp = 0; iComp < kNumThreads; ++iComp)
-				{
-					if (iComp == iThread)
-						continue;
+// Per node of all pools (like s_requiredLetters), the letters (5 bits each, from bit 3 on) of the chain that starts
+// below it and it's length (bits 0-2), if at least 2: each node along the way has a single child and no word, save
+// for the last. A single child is all there is to the children of it's parent (COMPACT_NODES), so it's followed
+// by it's own child directly: the last node is 'length'-1 nodes past the first child.
+static std::vector<uint32_t> s_chains;
 
-					const size_t compNodes   = s_threadInfo[iComp].nodes;
-					const size_t compLoad    = s_threadInfo[iComp].load;
-//					const size_t compNumBits = GetNumBits(s_threadDicts[iComp]->GetIndexBits());
+static_assert(RADIX_CHAIN_LENGTH <= 5);
 
-					if (unsigned(compNodes/(1+compLoad)) < curComp)
-					{
-						iThread = iComp;
-						break;
-					}
+static void FindChains()
+{
+	size_t numNodes = 0;
+	for (const auto& info : s_threadInfo)
+		numNodes += info.nodes;
+
+	s_chains.assign(numNodes, 0);
+
+	// Pristine, so every bit is still there.
+	const DictionaryNode* nodes = s_threadPools[0];
+	size_t numChains = 0, numSkipped = 0;
+	for (size_t iNode = 0; iNode < numNodes; ++iNode)
+	{
+		const DictionaryNode* node = nodes+iNode;
+
+		uint32_t letters = 0;
+		unsigned length = 0;
+		while (length < RADIX_CHAIN_LENGTH && 1 == CountBits(node->HasChildren()))
+		{
+			const unsigned letter = CountTrailingZeros64(node->HasChildren());
+			letters |= letter << (5*length++);
+
+			const DictionaryNode* child = node->GetChild(letter);
+			Assert(1 == length || child == node+1);
+			node = child;
+
+			if (node->HasWord())
+				break;
+		}
+
+		if (length >= 2)
+		{
+			s_chains[iNode] = length | letters << 3;
+			++numChains;
+			numSkipped += length-1;
+		}
+	}
+
+	debug_print("Found %zu chains (of %zu nodes), %zu nodes could be skipped.\n", numChains, numNodes, numSkipped);
+}
+
+#endif
+
+#if defined(GRANDCHILD_TABLES)
+
+// Per node of all pools (like s_requiredLetters), 1 + the index of it's table in s_grandchildTables, if it has one.
+static std::vector<uint32_t> s_grandchildIndices;
+
+// Per table, the offset (in bytes) from the node to each grandchild by child and grandchild letter (kLetterRange^2),
+// which is good for copies too; 0 if there's no such grandchild.
+static std::vector<uint32_t> s_grandchildTables;
+
+static void AddGrandchildTables(const DictionaryNode* nodes, const DictionaryNode* node, unsigned depth)
+{
+	constexpr unsigned kLetterRange = kAlphaRange+USE_EXTRA_INDEX;
+
+	unsigned indexBits = node->HasChildren();
+	if (CountBits(indexBits) >= GRANDCHILD_MIN_CHILDREN)
+	{
+		const size_t iTable = s_grandchildTables.size()/(kLetterRange*kLetterRange);
+		s_grandchildTables.resize(s_grandchildTables.size() + kLetterRange*kLetterRange, 0);
+		s_grandchildIndices[node-nodes] = uint32_t(iTable+1);
+
+		uint32_t* table = &s_grandchildTables[iTable*kLetterRange*kLetterRange];
+		for (unsigned children = indexBits; 0 != children; children &= children-1)
+		{
+			const unsigned letter = CountTrailingZeros64(children);
+			const DictionaryNode* child = node->GetChild(letter);
+
+			for (unsigned grandchildren = child->HasChildren(); 0 != grandchildren; grandchildren &= grandchildren-1)
+			{
+				const unsigned next = CountTrailingZeros64(grandchildren);
+				table[letter*kLetterRange + next] = uint32_t(reinterpret_cast<const char*>(child->GetChild(next)) - reinterpret_cast<const char*>(node));
+			}
+		}
+	}
+
+	if (depth < GRANDCHILD_MAX_DEPTH)
+	{
+		for (; 0 != indexBits; indexBits &= indexBits-1)
+			AddGrandchildTables(nodes, node->GetChild(CountTrailingZeros64(indexBits)), depth+1);
+	}
+}
+
+static void BuildGrandchildTables()
+{
+	size_t numNodes = 0;
+	for (const auto& info : s_threadInfo)
+		numNodes += info.nodes;
+
+	s_grandchildIndices.assign(numNodes, 0);
+	s_grandchildTables.clear();
+
+	for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+		AddGrandchildTables(s_threadPools[0], s_threadPools[iThread], 0);
+
+	const size_t numTables = s_grandchildTables.size()/((kAlphaRange+USE_EXTRA_INDEX)*(kAlphaRange+USE_EXTRA_INDEX));
+	debug_print("%zu grandchild tables (%zu KB), plus %zu KB to find them by node.\n", numTables, 
+		s_grandchildTables.size()*sizeof(uint32_t)/1024, numNodes*sizeof(uint32_t)/1024);
+}
+
+#endif
+
+#if defined(PREFIX_TABLE)
+
+// Per shard, the node of each two-letter prefix (by index, first*kAlphaRange + second) as an offset in bytes from the
+// root of it's pool, which makes it good for copies too; 0 if there's no such prefix.
+static std::vector<uint32_t> s_prefixTable;
+
+static void BuildPrefixTable()
+{
+	s_prefixTable.assign(kNumThreads*kAlphaRange*kAlphaRange, 0);
+
+	for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+	{
+		const DictionaryNode* root = s_threadPools[iThread];
+		uint32_t* offsets = &s_prefixTable[iThread*kAlphaRange*kAlphaRange];
+
+		for (unsigned first = USE_EXTRA_INDEX; first < kAlphaRange+USE_EXTRA_INDEX; ++first)
+		{
+			if (!root->HasChild(first))
+				continue;
+
+			// No word is a single letter (not even 'QU'), so there's nothing to find on the way.
+			const DictionaryNode* child = root->GetChild(first);
+			Assert(false == child->HasWord());
+
+			for (unsigned second = USE_EXTRA_INDEX; second < kAlphaRange+USE_EXTRA_INDEX; ++second)
+			{
+				if (child->HasChild(second))
+				{
+					const DictionaryNode* grandChild = child->GetChild(second);
+					offsets[(first-USE_EXTRA_INDEX)*kAlphaRange + second-USE_EXTRA_INDEX] = uint32_t(reinterpret_cast<const char*>(grandChild) - reinterpret_cast<const char*>(root));
 				}
 			}
-			else
+		}
+	}
+}
+
+#endif
+
+#if defined(DOUBLE_ARRAY_TRIE)
+
+// State S goes to T = S's base + letter on that letter if T's check is S; the root is state 0.
+class DoubleArraySlot
+{
+public:
+	int32_t base;
+	int32_t check; // Or kFreeSlot, kRootSlot
+};
+
+constexpr int32_t kFreeSlot = -1;
+constexpr int32_t kRootSlot = -2;
+
+// One per shard, built from it's pool.
+class DoubleArray
+{
+public:
+	std::vector<DoubleArraySlot> slots;
+	std::vector<int32_t> words;     // Per state, -1 if none
+	std::vector<uint32_t> children; // Per state, letter bits (to tell when all of them are done)
+	size_t numStates;
+};
+
+static std::vector<DoubleArray> s_doubleArrays;
+
+// Breadth first, each state's children go to the first base where all of them fit. The slots are padded at the end so
+// that any state plus any letter stays within them (no bounds check needed).
+static void BuildDoubleArray(const DictionaryNode* root, size_t numNodes, DoubleArray& array)
+{
+	constexpr unsigned kLetterRange = kAlphaRange+USE_EXTRA_INDEX;
+
+	auto& slots = array.slots;
+	slots.assign(numNodes + kLetterRange, DoubleArraySlot{ 0, kFreeSlot });
+	slots[0].check = kRootSlot;
+
+	auto reserve = [&slots](size_t size)
+	{
+		if (size > slots.size())
+			slots.resize(std::max(size, slots.size() + slots.size()/4), DoubleArraySlot{ 0, kFreeSlot });
+	};
+
+	std::vector<std::pair<const DictionaryNode*, int32_t>> queue;
+	queue.emplace_back(root, 0);
+
+	std::vector<int32_t> words(1, -1);
+	std::vector<uint32_t> children(1, 0);
+
+	size_t firstFree = 1;
+	for (size_t iQueue = 0; iQueue < queue.size(); ++iQueue)
+	{
+		const DictionaryNode* node = queue[iQueue].first;
+		const int32_t state = queue[iQueue].second;
+
+		const unsigned indexBits = node->HasChildren();
+		words[state] = node->GetWordIndex();
+		children[state] = indexBits;
+
+		if (0 == indexBits)
+			continue;
+
+		const unsigned first = CountTrailingZeros64(indexBits);
+
+		// Try each free slot (from the first one) for the first letter.
+		size_t base;
+		for (size_t slot = std::max<size_t>(firstFree, first+1); ; ++slot)
+		{
+			reserve(slot + kLetterRange + 1);
+			if (kFreeSlot != slots[slot].check)
+				continue;
+
+			base = slot-first;
+
+			bool fits = true;
+			for (unsigned letters = indexBits & (indexBits-1); 0 != letters && fits; letters &= letters-1)
+				fits = kFreeSlot == slots[base + CountTrailingZeros64(letters)].check;
+
+			if (fits)
+				break;
+		}
+
+		slots[state].base = int32_t(base);
+		for (unsigned letters = indexBits; 0 != letters; letters &= letters-1)
+		{
+			const unsigned letter = CountTrailingZeros64(letters);
+			const size_t child = base+letter;
+
+			slots[child].check = state;
+			queue.emplace_back(node->GetChild(letter), int32_t(child));
+
+			if (child >= words.size())
+			{
+				words.resize(child+1, -1);
+				children.resize(child+1, 0);
+			}
+		}
+
+		while (kFreeSlot != slots[firstFree].check)
+			++firstFree;
+	}
+
+	// Trim to the last slot in use plus padding.
+	size_t numStates = slots.size();
+	while (numStates > 1 && kFreeSlot == slots[numStates-1].check)
+		--numStates;
+
+	slots.resize(numStates + kLetterRange);
+	slots.shrink_to_fit();
+
+	words.resize(numStates, -1);
+	children.resize(numStates, 0);
+
+	array.words = std::move(words);
+	array.children = std::move(children);
+	array.numStates = numStates;
+}
+
+static void BuildDoubleArrays()
+{
+	s_doubleArrays.resize(kNumThreads);
+
+	size_t numNodes = 0, numSlots = 0;
+	for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+	{
+		BuildDoubleArray(s_threadPools[iThread], s_threadInfo[iThread].nodes, s_doubleArrays[iThread]);
+		numNodes += s_threadInfo[iThread].nodes;
+		numSlots += s_doubleArrays[iThread].slots.size();
+	}
+
+	debug_print("Double array: %zu slots for %zu states (%zu KB, plus %zu KB for words and children).\n", numSlots, numNodes, 
+		numSlots*sizeof(DoubleArraySlot)/1024, numSlots*(sizeof(int32_t)+sizeof(uint32_t))/1024);
+}
+
+#endif
+
+#if defined(DAWG_DICTIONARY)
+
+constexpr uint32_t kDawgWordBit = 1u<<31;
+
+class DawgNode
+{
+public:
+	uint32_t indexBits; // Plus kDawgWordBit if a word ends here
+	uint32_t firstEdge; // One edge per child, by letter
+	uint32_t numWords;  // Here and below
+};
+
+class DawgEdge
+{
+public:
+	uint32_t node;
+	uint32_t skip; // Ranks passed going this way: this node's word, if any, plus all words below smaller letters
+};
+
+// One per shard, built from it's pool.
+class Dawg
+{
+public:
+	std::vector<DawgNode> nodes; // Root first
+	std::vector<DawgEdge> edges;
+	std::vector<uint32_t> words; // Word index by rank (alphabetical order within the shard)
+};
+
+static std::vector<Dawg> s_dawgs;
+
+// Merges 'node' with any identical node already added (same word flag, same children), bottom up, so equal suffixes
+// are only stored once; returns it's index.
+static uint32_t AddDawgNode(const DictionaryNode* node, Dawg& dawg, std::unordered_map<std::string, uint32_t>& unique)
+{
+	const unsigned indexBits = node->HasChildren();
+
+	std::vector<uint32_t> key;
+	key.push_back(indexBits | (node->HasWord() ? kDawgWordBit : 0));
+	for (unsigned letters = indexBits; 0 != letters; letters &= letters-1)
+		key.push_back(AddDawgNode(node->GetChild(CountTrailingZeros64(letters)), dawg, unique));
+
+	std::string signature(reinterpret_cast<const char*>(key.data()), key.size()*sizeof(uint32_t));
+	const auto found = unique.find(signature);
+	if (unique.end() != found)
+		return found->second;
+
+	DawgNode added;
+	added.indexBits = key[0];
+	added.firstEdge = uint32_t(dawg.edges.size());
+	added.numWords = node->HasWord() ? 1 : 0;
+
+	for (size_t iChild = 1; iChild < key.size(); ++iChild)
+	{
+		DawgEdge edge;
+		edge.node = key[iChild];
+		edge.skip = added.numWords;
+		dawg.edges.push_back(edge);
+
+		added.numWords += dawg.nodes[edge.node].numWords;
+	}
+
+	const uint32_t index = uint32_t(dawg.nodes.size());
+	dawg.nodes.push_back(added);
+	unique.emplace(std::move(signature), index);
+	return index;
+}
+
+// Word indices in rank order, which is the order a traversal (word first, then children by letter) runs into them.
+static void AddDawgWords(const DictionaryNode* node, std::vector<uint32_t>& words)
+{
+	if (node->HasWord())
+		words.push_back(uint32_t(node->GetWordIndex()));
+
+	for (unsigned letters = node->HasChildren(); 0 != letters; letters &= letters-1)
+		AddDawgWords(node->GetChild(CountTrailingZeros64(letters)), words);
+}
+
+static void BuildDawg(const DictionaryNode* root, Dawg& dawg)
+{
+	dawg.nodes.clear();
+	dawg.edges.clear();
+
+	std::unordered_map<std::string, uint32_t> unique;
+	const uint32_t rootIndex = AddDawgNode(root, dawg, unique);
+
+	// Children went in before their parents: flip it all around so the root is 0 and a traversal heads up in memory.
+	const uint32_t last = rootIndex;
+	std::reverse(dawg.nodes.begin(), dawg.nodes.end());
+	for (auto& edge : dawg.edges)
+		edge.node = last-edge.node;
+
+	dawg.words.clear();
+	AddDawgWords(root, dawg.words);
+	Assert(dawg.words.size() == dawg.nodes[0].numWords);
+}
+
+static void BuildDawgs()
+{
+	s_dawgs.resize(kNumThreads);
+
+	size_t numNodes = 0, numDawgNodes = 0, numEdges = 0;
+	for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+	{
+		BuildDawg(s_threadPools[iThread], s_dawgs[iThread]);
+		numNodes += s_threadInfo[iThread].nodes;
+		numDawgNodes += s_dawgs[iThread].nodes.size();
+		numEdges += s_dawgs[iThread].edges.size();
+	}
+
+	debug_print("DAWG: %zu nodes (was %zu) and %zu edges, %zu KB.\n", numDawgNodes, numNodes, numEdges,
+		(numDawgNodes*sizeof(DawgNode) + numEdges*sizeof(DawgEdge))/1024);
+}
+
+#endif
+
+#if defined(LOUDS_TRIE)
+
+// One per shard, built from it's pool. Nodes are numbered breadth first (root 0, the children of a node side by side
+// in letter order), so all there is to the shape is 'tree': a 0, then per node a 1 per child and a 0. Node N's 1s then
+// start right after the N-th 0 (select), and the 1s before those (rank) tell which node is it's first child.
+class LoudsTrie
+{
+public:
+	std::vector<uint64_t> tree;        // Plus a word to read past the end
+	std::vector<uint32_t> treeRanks;   // Per word of 'tree', the 1s before it
+	std::vector<uint32_t> zeroSamples; // Per 64 0s of 'tree', the word the first of them is in
+	std::vector<uint8_t>  labels;      // Per node, the letter that leads to it
+	std::vector<uint64_t> wordBits;    // Per node, whether a word ends there
+	std::vector<uint32_t> wordRanks;   // Per word of 'wordBits', the 1s before it
+	std::vector<uint32_t> words;       // Word index by rank in 'wordBits'
+	uint32_t numNodes;
+	uint32_t rootLetters;
+
+	// Position of the N-th (0-based) 0 in 'tree'.
+	BOGGLE_INLINE_FORCE uint32_t Select0(uint32_t n) const
+	{
+		size_t iWord = zeroSamples[n >> 6];
+		unsigned left = n - unsigned(iWord*64 - treeRanks[iWord]);
+		for (;;)
+		{
+			const unsigned zeros = 64 - CountBits64(tree[iWord]);
+			if (left < zeros)
+				break;
+
+			left -= zeros;
+			++iWord;
+		}
+
+		return uint32_t(iWord*64) + SelectBit64(~tree[iWord], left);
+	}
+
+	// Returns the number of children of 'node' (no more than the letter range), the first of which goes in 'first'.
+	BOGGLE_INLINE_FORCE unsigned GetChildren(uint32_t node, uint32_t& first) const
+	{
+		const uint32_t start = Select0(node)+1;
+		const uint64_t* bits = &tree[start >> 6];
+		const unsigned shift = start & 63;
+
+		first = treeRanks[start >> 6] + CountBits64(bits[0] & ((1ull << shift)-1)) + 1;
+
+		const uint64_t window = (0 == shift) ? bits[0] : bits[0] >> shift | bits[1] << (64-shift);
+		return CountTrailingZeros64(~window);
+	}
+
+	BOGGLE_INLINE_FORCE bool HasWord(uint32_t node) const
+	{
+		return 0 != (wordBits[node >> 6] & (1ull << (node & 63)));
+	}
+
+	BOGGLE_INLINE_FORCE unsigned GetWordIndex(uint32_t node) const
+	{
+		return words[wordRanks[node >> 6] + CountBits64(wordBits[node >> 6] & ((1ull << (node & 63))-1))];
+	}
+
+	size_t GetSize() const
+	{
+		return tree.size()*sizeof(uint64_t) + treeRanks.size()*sizeof(uint32_t) + zeroSamples.size()*sizeof(uint32_t) +
+			labels.size() + wordBits.size()*sizeof(uint64_t) + wordRanks.size()*sizeof(uint32_t) + words.size()*sizeof(uint32_t);
+	}
+};
+
+static std::vector<LoudsTrie> s_loudsTries;
+
+// Rank per word of 'bits' (the 1s before it).
+static void BuildRanks(const std::vector<uint64_t>& bits, std::vector<uint32_t>& ranks)
+{
+	ranks.resize(bits.size());
+
+	uint32_t ones = 0;
+	for (size_t iWord = 0; iWord < bits.size(); ++iWord)
+	{
+		ranks[iWord] = ones;
+		ones += CountBits64(bits[iWord]);
+	}
+}
+
+static void BuildLouds(const DictionaryNode* root, LoudsTrie& louds)
+{
+	std::vector<const DictionaryNode*> queue;
+	queue.push_back(root);
+
+	std::vector<uint64_t> tree;
+	size_t numBits = 1; // The leading 0
+
+	auto addBit = [&tree, &numBits](bool one)
+	{
+		if (0 == (numBits & 63))
+			tree.push_back(0);
+
+		if (true == one)
+			tree[numBits >> 6] |= 1ull << (numBits & 63);
+
+		++numBits;
+	};
+
+	tree.push_back(0);
+
+	louds.labels.assign(1, 0);
+	louds.words.clear();
+
+	std::vector<uint64_t> wordBits;
+	for (size_t iQueue = 0; iQueue < queue.size(); ++iQueue)
+	{
+		const DictionaryNode* node = queue[iQueue];
+
+		if (0 == (iQueue & 63))
+			wordBits.push_back(0);
+
+		if (node->HasWord())
+		{
+			wordBits[iQueue >> 6] |= 1ull << (iQueue & 63);
+			louds.words.push_back(uint32_t(node->GetWordIndex()));
+		}
+
+		for (unsigned letters = node->HasChildren(); 0 != letters; letters &= letters-1)
+		{
+			const unsigned letter = CountTrailingZeros64(letters);
+			louds.labels.push_back(uint8_t(letter));
+			queue.push_back(node->GetChild(letter));
+			addBit(true);
+		}
+
+		addBit(false);
+	}
+
+	tree.push_back(0);
+
+	// Every 64th 0 (padding included, which is never selected).
+	louds.zeroSamples.clear();
+	size_t numZeros = 0;
+	for (size_t iWord = 0; iWord < tree.size(); ++iWord)
+	{
+		const size_t wordZeros = 64 - CountBits64(tree[iWord]);
+		while (louds.zeroSamples.size()*64 < numZeros+wordZeros)
+			louds.zeroSamples.push_back(uint32_t(iWord));
+
+		numZeros += wordZeros;
+	}
+
+	BuildRanks(tree, louds.treeRanks);
+	BuildRanks(wordBits, louds.wordRanks);
+
+	louds.tree = std::move(tree);
+	louds.wordBits = std::move(wordBits);
+	louds.numNodes = uint32_t(queue.size());
+	louds.rootLetters = root->HasChildren();
+}
+
+static void BuildLoudsTries()
+{
+	s_loudsTries.resize(kNumThreads);
+
+	size_t numNodes = 0, size = 0;
+	for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+	{
+		BuildLouds(s_threadPools[iThread], s_loudsTries[iThread]);
+		numNodes += s_loudsTries[iThread].numNodes;
+		size += s_loudsTries[iThread].GetSize();
+	}
+
+	debug_print("LOUDS: %zu nodes, %zu KB (%.1f bits a node, word indices included).\n", numNodes, size/1024, 8.0*size/numNodes);
+
+	// Nothing reads the pools from here on, so unless they're mapped (image) let go of them.
+	if (nullptr != s_poolStorage)
+	{
+		freeAligned(s_poolStorage);
+		s_poolStorage = nullptr;
+		s_threadPools.clear();
+#if defined(HOT_COLD_NODES)
+		s_requiredLetters = nullptr;
+#endif
+	}
+}
+
+#endif
+
+#if defined(PREFIX_HASH_ENGINE)
+
+// Set by UsePrefixHash().
+static bool s_usePrefixHash = false;
+
+constexpr uint32_t kEmptyPrefix = ~0u;
+constexpr uint32_t kNoPrefix    = ~0u;
+
+constexpr uint8_t kPrefixWord = 1; // Is a word
+
+class PrefixHashEntry
+{
+public:
+	uint32_t key;     // Slot of the prefix a letter shorter << 5 | letter, or kEmptyPrefix
+	uint32_t word;    // Word index, if kPrefixWord
+	uint32_t letters; // Letters that may follow (has an extension if not 0), so only those are probed
+	uint8_t flags;
+};
+
+constexpr unsigned kPrefixBucketSize = unsigned(kCacheLineSize/sizeof(PrefixHashEntry));
+
+class alignas(kCacheLineSize) PrefixBucket
+{
+public:
+	PrefixHashEntry entries[kPrefixBucketSize];
+};
+
+// One per shard, built from it's pool. A slot is a bucket times kPrefixBucketSize plus an entry; the root isn't in
+// there, but goes by slot 'numSlots' (so GetKey() is the same for any prefix).
+class PrefixHash
+{
+public:
+	std::vector<PrefixBucket> buckets; // Power of 2
+	uint32_t numSlots;
+	unsigned shift;                    // 64 minus log2 of the number of buckets
+
+	BOGGLE_INLINE_FORCE static uint32_t GetKey(uint32_t slot, unsigned letter)
+	{
+		return slot << 5 | letter;
+	}
+
+	// Fibonacci hashing: the top bits of the product.
+	BOGGLE_INLINE_FORCE size_t GetBucket(uint32_t key) const
+	{
+		return size_t((key * 0x9e3779b97f4a7c15ull) >> shift);
+	}
+
+	BOGGLE_INLINE_FORCE const PrefixHashEntry& GetEntry(uint32_t slot) const
+	{
+		return buckets[slot/kPrefixBucketSize].entries[slot%kPrefixBucketSize];
+	}
+
+	// Linear probing, bucket by bucket; there's always a free entry somewhere, so it stops.
+	BOGGLE_INLINE_FORCE uint32_t Find(uint32_t key, size_t iBucket) const
+	{
+		const size_t mask = buckets.size()-1;
+		for (;; iBucket = (iBucket+1) & mask)
+		{
+			const PrefixHashEntry* entries = buckets[iBucket].entries;
+			for (unsigned iEntry = 0; iEntry < kPrefixBucketSize; ++iEntry)
+			{
+				if (key == entries[iEntry].key)
+					return uint32_t(iBucket*kPrefixBucketSize + iEntry);
+
+				if (kEmptyPrefix == entries[iEntry].key)
+					return kNoPrefix;
+			}
+		}
+	}
+
+	uint32_t Insert(const PrefixHashEntry& added)
+	{
+		const size_t mask = buckets.size()-1;
+		for (size_t iBucket = GetBucket(added.key); ; iBucket = (iBucket+1) & mask)
+		{
+			PrefixHashEntry* entries = buckets[iBucket].entries;
+			for (unsigned iEntry = 0; iEntry < kPrefixBucketSize; ++iEntry)
+			{
+				if (kEmptyPrefix == entries[iEntry].key)
+				{
+					entries[iEntry] = added;
+					return uint32_t(iBucket*kPrefixBucketSize + iEntry);
+				}
+			}
+		}
+	}
+};
+
+static std::vector<PrefixHash> s_prefixHashes;
+
+static void AddPrefixes(const DictionaryNode* node, uint32_t slot, PrefixHash& hash)
+{
+	for (unsigned letters = node->HasChildren(); 0 != letters; letters &= letters-1)
+	{
+		const unsigned letter = CountTrailingZeros64(letters);
+		const DictionaryNode* child = node->GetChild(letter);
+
+		PrefixHashEntry added;
+		added.key = PrefixHash::GetKey(slot, letter);
+		added.word = child->HasWord() ? uint32_t(child->GetWordIndex()) : 0;
+		added.letters = child->HasChildren();
+		added.flags = child->HasWord() ? kPrefixWord : 0;
+		const uint32_t childSlot = hash.Insert(added);
+
+		AddPrefixes(child, childSlot, hash);
+	}
+}
+
+// At most 7/8 full: with a bucket per cache line, a probe rarely has to look past the first one even then.
+static void BuildPrefixHash(const DictionaryNode* root, size_t numNodes, PrefixHash& hash)
+{
+	const size_t numBuckets = std::max<size_t>(2, RoundPow2_64((numNodes*8/7)/kPrefixBucketSize + 1));
+	Assert(numBuckets*kPrefixBucketSize < (1u << 27)); // See GetKey()
+
+	PrefixBucket empty;
+	for (auto& entry : empty.entries)
+		entry = PrefixHashEntry{ kEmptyPrefix, 0, 0, 0 };
+
+	hash.buckets.assign(numBuckets, empty);
+	hash.numSlots = uint32_t(numBuckets*kPrefixBucketSize);
+	hash.shift = 64 - CountTrailingZeros64(numBuckets);
+
+	AddPrefixes(root, hash.numSlots, hash);
+}
+
+static void BuildPrefixHashes()
+{
+	s_prefixHashes.resize(kNumThreads);
+
+	size_t numNodes = 0, numBuckets = 0;
+	for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+	{
+		BuildPrefixHash(s_threadPools[iThread], s_threadInfo[iThread].nodes, s_prefixHashes[iThread]);
+		numNodes += s_threadInfo[iThread].nodes;
+		numBuckets += s_prefixHashes[iThread].buckets.size();
+	}
+
+	debug_print("Prefix hash: %zu prefixes in %zu buckets (%zu KB, %.0f%% full).\n", numNodes-kNumThreads, numBuckets, 
+		numBuckets*sizeof(PrefixBucket)/1024, 100.0*(numNodes-kNumThreads)/(numBuckets*kPrefixBucketSize));
+}
+
+#endif
+
+// Call once a dictionary is in place.
+static void CreateWorkers()
+{
+	s_threadCustomAlloc.resize(kNumThreads);
+	s_threadHeapSizes.assign(kNumThreads, 0);
+	s_threadWordsFound.resize(kNumThreads);
+
+#if defined(WORK_STEALING)
+	s_threadDeques = std::make_unique<WorkStealingDeque<uint32_t>[]>(kNumThreads);
+	CountPrefixNodes();
+#endif
+
+#if defined(PREFIX_TABLE)
+	BuildPrefixTable();
+#endif
+
+#if defined(RADIX_CHAINS)
+	FindChains();
+#endif
+
+#if defined(GRANDCHILD_TABLES)
+	BuildGrandchildTables();
+#endif
+
+#if defined(DOUBLE_ARRAY_TRIE)
+	BuildDoubleArrays();
+#endif
+
+#if defined(DAWG_DICTIONARY)
+	BuildDawgs();
+#endif
+
+#if defined(LOUDS_TRIE)
+	BuildLoudsTries();
+#endif
+
+#if defined(PREFIX_HASH_ENGINE)
+	if (true == s_usePrefixHash)
+		BuildPrefixHashes();
+#endif
+
+#if defined(BOARD_PARTITIONING)
+	s_workerStates.assign(kNumThreads, nullptr);
+	s_workerEpochs.assign(kNumThreads, 0);
+#endif
+
+	s_workerPool = std::make_unique<WorkerPool>(kNumThreads);
+}
+
+static void DestroyWorkers()
+{
+	s_workerPool.reset();
+
+	for (unsigned iThread = 0; iThread < s_threadHeapSizes.size(); ++iThread)
+	{
+		if (0 != s_threadHeapSizes[iThread])
+			freeAligned(s_threadCustomAlloc[iThread].GetPool());
+	}
+
+	s_threadCustomAlloc.clear();
+	s_threadHeapSizes.clear();
+	s_threadWordsFound.clear();
+
+#if defined(WORK_STEALING)
+	s_threadDeques.reset();
+	s_prefixNodes.clear();
+#endif
+
+#if defined(PREFIX_TABLE)
+	s_prefixTable.clear();
+#endif
+
+#if defined(RADIX_CHAINS)
+	s_chains.clear();
+#endif
+
+#if defined(GRANDCHILD_TABLES)
+	s_grandchildIndices.clear();
+	s_grandchildTables.clear();
+#endif
+
+#if defined(DOUBLE_ARRAY_TRIE)
+	s_doubleArrays.clear();
+#endif
+
+#if defined(DAWG_DICTIONARY)
+	s_dawgs.clear();
+#endif
+
+#if defined(LOUDS_TRIE)
+	s_loudsTries.clear();
+#endif
+
+#if defined(PREFIX_HASH_ENGINE)
+	s_prefixHashes.clear();
+#endif
+
+#if defined(BOARD_PARTITIONING)
+	for (auto* states : s_workerStates)
+		freeAligned(states);
+
+	s_workerStates.clear();
+	s_workerEpochs.clear();
+#endif
+}
+
+// Only to be called by the thread's own worker.
+static void ResetThreadHeap(unsigned iThread, size_t size)
+{
+	if (size > s_threadHeapSizes[iThread])
+	{
+		if (0 != s_threadHeapSizes[iThread])
+			freeAligned(s_threadCustomAlloc[iThread].GetPool());
+
+		// Allocated by the worker itself, so on it's own NUMA node.
+		size = RoundPow2_64(size);
+		s_threadCustomAlloc[iThread] = CustomAlloc(static_cast<char*>(mallocAligned(size, kPageSize)), size);
+		s_threadHeapSizes[iThread] = size;
+	}
+	else
+	{
+		s_threadCustomAlloc[iThread].Reset(s_threadHeapSizes[iThread]);
+	}
+}
+
+// We keep one dictionary at a time so it's access is protected by a mutex, just to be safe.
+static std::mutex s_dictMutex;
+
+// Counters, the latter being useful to reserve space.
+static unsigned s_longestWord;
+static size_t s_wordCount;
+
+BOGGLE_INLINE static unsigned GetWordScore_Readable(size_t length) /* const */
+{
+	length -= 3;
+	length = length > 5 ? 5 : length; // This nicely compiles to a conditional move
+
+	constexpr unsigned kLUT[] = { 1, 1, 2, 3, 5, 11 };
+	return kLUT[length];
+}
+
+BOGGLE_INLINE static uint8_t GetWordScore_Albert(size_t length) /* const */
+{
+	length = length > 8 ? 8 : length;
+
+	// Courtesy of Albert Sandberg, the bit magician.
+	size_t Albert = 0;
+	Albert += (length-3)>>1;
+	Albert += (length+10)>>4;
+	Albert += (length+9)>>4;
+	Albert += length<<2>>5<<2;
+	Albert += length<<2>>5<<1;
+	return uint8_t(Albert+1);
+}
+
+#ifdef NED_FLANDERS
+// Scoped lock for all dictionary globals.
+class DictionaryLock
+{
+public:
+	DictionaryLock() :
+		m_lock(s_dictMutex) {}
+private:
+	std::lock_guard<std::mutex> m_lock;
+};
+#endif // NED_FLANDERS
+
+// A word as found in the dictionary text (uppercased copy), valid or not, so the load balancing below sees every one of them.
+struct ParsedWord
+{
+	uint32_t offset;
+	uint32_t length;
+	bool valid;
+};
+
+// Parses at least this many bytes per thread.
+constexpr size_t kMinParseChunk = 64*1024;
+
+// Undef. to parse the dictionary the old way, character by character (for comparison).
+// #define SCALAR_DICTIONARY_PARSER
+
+#if defined(SCALAR_DICTIONARY_PARSER)
+
+// Tells us if a word adheres to the rules.
+static bool IsWordValid(const std::string& word)
+{
+	const size_t length = word.length();
+
+	// Word not too short?
+	if (length < 3 || length > MAX_WORD_LEN)
+	{
+		debug_print("Invalid word because it's got less than 3 or more than %u letters: %s\n", MAX_WORD_LEN, word.c_str());
+		return false;
+	}
+
+	// Check if it violates the 'Qu' rule.
+	std::string mutWord = word;
+	auto iQ = mutWord.find_first_of('Q');
+	while (std::string::npos != iQ)
+	{
+		auto next = iQ+1;
+		if (next == length || mutWord[next] != 'U')
+		{
+			debug_print("Invalid word due to 'Qu' rule: %s\n", word.c_str());
+			return false;
+		}
+
+		mutWord = mutWord.substr(next);
+		iQ = mutWord.find_first_of('Q');
+	}
+
+	return true;
+}
+
+static bool ParseDictionary(const char* path, std::vector<char>& upper, std::vector<ParsedWord>& words)
+{
+	FILE* file = fopen(path, "r");
+	if (nullptr == file)
+		return false;
+
+	int character;
+	std::string word;
+
+	do
+	{
+		character = fgetc(file);
+		if (0 != isalpha((unsigned char) character))
+		{
+			// Boggle tiles are simply A-Z, where Q means 'Qu'.
+			word += toupper(character);
+		}
+		else
+		{
+			// We've hit EOF or a non-alphanumeric character.
+			if (false == word.empty()) // Got a word?
+			{
+				words.push_back({ uint32_t(upper.size()), uint32_t(word.length()), IsWordValid(word) });
+				upper.insert(upper.end(), word.begin(), word.end());
+				word.clear();
+			}
+		}
+	}
+	while (EOF != character);
+
+	fclose(file);
+
+	return true;
+}
+
+#else
+
+// Classifies 64 characters: writes them uppercased and returns a mask of letters, 'Q's and 'U's.
+BOGGLE_INLINE_FORCE static void ScanDictionaryBlock(const char* text, char* upper, uint64_t& alpha, uint64_t& Q, uint64_t& U)
+{
+	alpha = Q = U = 0;
+
+	// Bytes with the top bit set compare as negative, so they aren't letters, just like isalpha() in the "C" locale.
+#if defined(__AVX2__)
+	for (unsigned iLane = 0; iLane < 64; iLane += 32)
+	{
+		const __m256i chars   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text+iLane));
+		const __m256i isLower = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('a'-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z'+1), chars));
+		const __m256i upper32 = _mm256_sub_epi8(chars, _mm256_and_si256(isLower, _mm256_set1_epi8(0x20)));
+		const __m256i isAlpha = _mm256_and_si256(_mm256_cmpgt_epi8(upper32, _mm256_set1_epi8('A'-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z'+1), upper32));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(upper+iLane), upper32);
+
+		alpha |= uint64_t(uint32_t(_mm256_movemask_epi8(isAlpha))) << iLane;
+		Q |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(upper32, _mm256_set1_epi8('Q'))))) << iLane;
+		U |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(upper32, _mm256_set1_epi8('U'))))) << iLane;
+	}
+#else
+	for (unsigned iLane = 0; iLane < 64; iLane += 16)
+	{
+		const __m128i chars   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text+iLane));
+		const __m128i isLower = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('a'-1)), _mm_cmpgt_epi8(_mm_set1_epi8('z'+1), chars));
+		const __m128i upper16 = _mm_sub_epi8(chars, _mm_and_si128(isLower, _mm_set1_epi8(0x20)));
+		const __m128i isAlpha = _mm_and_si128(_mm_cmpgt_epi8(upper16, _mm_set1_epi8('A'-1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z'+1), upper16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(upper+iLane), upper16);
+
+		alpha |= uint64_t(_mm_movemask_epi8(isAlpha)) << iLane;
+		Q |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(upper16, _mm_set1_epi8('Q')))) << iLane;
+		U |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(upper16, _mm_set1_epi8('U')))) << iLane;
+	}
+#endif
+}
+
+// Parses [begin, end), which may not split a word, 64 characters at a time.
+static void ParseDictionaryChunk(const char* text, char* upper, size_t begin, size_t end, std::vector<ParsedWord>& words)
+{
+	uint64_t prevAlpha = 0, prevQ = 0; // Last character of the previous block
+	size_t wordStart = begin;
+	bool wordValid = true;
+
+	for (size_t iBlock = begin; iBlock < end; iBlock += 64)
+	{
+		uint64_t alpha, Q, U;
+
+		if (iBlock+64 <= end)
+		{
+			ScanDictionaryBlock(text+iBlock, upper+iBlock, alpha, Q, U);
+		}
+		else
+		{
+			// Tail: zero padding acts as a separator, and we can't write past 'end' (another thread's chunk).
+			char textTail[64] = { 0 }, upperTail[64];
+			memcpy(textTail, text+iBlock, end-iBlock);
+			ScanDictionaryBlock(textTail, upperTail, alpha, Q, U);
+			memcpy(upper+iBlock, upperTail, end-iBlock);
+		}
+
+		// Word starts, (exclusive) ends and characters following a 'Q' that aren't a 'U'.
+		const uint64_t starts = alpha & ~((alpha << 1) | prevAlpha);
+		const uint64_t ends   = ~alpha & ((alpha << 1) | prevAlpha);
+		const uint64_t badQ   = ((Q << 1) | prevQ) & ~U;
+
+		prevAlpha = alpha >> 63;
+		prevQ = Q >> 63;
+
+		for (uint64_t events = starts|ends|badQ; 0 != events; events &= events-1)
+		{
+			const unsigned iBit = CountTrailingZeros64(events);
+			const uint64_t bit = uint64_t(1) << iBit;
+
+			// Check before ending the word: a word can end right where it's 'Q' wasn't answered.
+			if (badQ & bit)
+				wordValid = false;
+
+			if (starts & bit)
+			{
+				wordStart = iBlock+iBit;
+				wordValid = true;
+			}
+			else if (ends & bit)
+			{
+				const size_t length = iBlock+iBit-wordStart;
+				words.push_back({ uint32_t(wordStart), uint32_t(length), wordValid && length >= 3 && length <= MAX_WORD_LEN });
+			}
+		}
+	}
+
+	// Only the last chunk can end on a full block with a word still open (EOF).
+	if (0 != prevAlpha)
+	{
+		const size_t length = end-wordStart;
+		words.push_back({ uint32_t(wordStart), uint32_t(length), wordValid && 0 == prevQ && length >= 3 && length <= MAX_WORD_LEN });
+	}
+}
+
+// Maps the file and parses it in (word aligned) chunks, in parallel; yields exactly what the old fgetc() loop did.
+static bool ParseDictionary(const char* path, std::vector<char>& upper, std::vector<ParsedWord>& words)
+{
+	size_t size;
+	const char* text = static_cast<const char*>(mapFile(path, &size));
+	if (nullptr == text)
+		return false;
+
+	Assert(size <= 0xffffffff);
+
+	const size_t numChunks = std::max<size_t>(1, std::min(kNumThreads, size/kMinParseChunk));
+
+	// Chunks may only start right after a separator (in practice a line break).
+	std::vector<size_t> bounds(numChunks+1, size);
+	bounds[0] = 0;
+	for (size_t iChunk = 1; iChunk < numChunks; ++iChunk)
+	{
+		size_t bound = std::max(iChunk*(size/numChunks), bounds[iChunk-1]);
+		while (bound < size && 0 != isalpha((unsigned char) text[bound-1]))
+			++bound;
+
+		bounds[iChunk] = bound;
+	}
+
+	upper.resize(size);
+	std::vector<std::vector<ParsedWord>> chunkWords(numChunks);
+
+	#pragma omp parallel for schedule(static, 1) num_threads(int(numChunks))
+	for (int iChunk = 0; iChunk < int(numChunks); ++iChunk)
+	{
+		chunkWords[iChunk].reserve((bounds[iChunk+1]-bounds[iChunk])/8);
+		ParseDictionaryChunk(text, upper.data(), bounds[iChunk], bounds[iChunk+1], chunkWords[iChunk]);
+	}
+
+	unmapFile(text, size);
+
+	// In order, so word indices don't depend on the number of chunks.
+	for (const auto& chunk : chunkWords)
+		words.insert(words.end(), chunk.begin(), chunk.end());
+
+	return true;
+}
+
+#endif // SCALAR_DICTIONARY_PARSER
+
+// Input word must be uppercase and valid (new nodes count towards thread 'iThread').
+/* static */ void AddWordToTree(LoadDictionaryNode* node, const char* word, unsigned length, int32_t wordIdx, size_t iThread)
+{
+	Assert(nullptr != node);
+
+	for (unsigned iLetter = 0; iLetter < length; ++iLetter)
+	{
+		const char letter = word[iLetter];
+
+		// Get or create child node.
+		node = node->AddChild(letter, iThread);
+
+		// Handle 'Qu' rule.
+		if ('Q' == letter)
+		{
+			// Verified to be 'Qu' by the parser.
+			// Skip over 'U'.
+			++iLetter;
+		}
+	}
+
+	// Store index in node.
+	node->m_wordIdx = wordIdx;
+}
+
+/* static */ void AddWordToDictionary(const char* word, unsigned length, size_t iThread)
+{
+	if (length > s_longestWord)
+	{
+		s_longestWord = length;
+	}
+
+	AddWordToTree(s_threadDicts[iThread], word, length, int32_t(s_wordCount), iThread);
+
+	// Store word in dictionary (FIXME: less ham-fisted please).
+	s_words.emplace_back(Word(GetWordScore_Albert(length), word, length));
+
+	++s_threadInfo[iThread].load;
+	++s_wordCount;
+}
+
+// Shard per two-letter prefix (first*kAlphaRange + second, 0-based), if calibrated, and what it was calibrated for;
+// kept across dictionaries so reloading the same one (or it's image) doesn't calibrate all over again.
+constexpr uint16_t kNoShard = 0xffff;
+
+static std::vector<uint16_t> s_partition;
+static uint64_t s_partitionKey = 0;
+
+#if defined(CALIBRATED_SHARDING)
+
+// Word must be valid.
+BOGGLE_INLINE static unsigned GetWordPrefix(const char* word)
+{
+	const unsigned second = ('Q' == word[0]) ? 2 : 1; // Skip 'U'
+	return (word[0]-'A')*kAlphaRange + (word[second]-'A');
+}
+
+// FWD.
+static uint64_t GetImageChecksum(const char* data, size_t size);
+
+// Changes if the dictionary, the number of threads or the calibration itself does; never zero.
+static uint64_t GetPartitionKey(const std::vector<char>& upper)
+{
+	const uint64_t parameters[] = { GetImageChecksum(upper.data(), upper.size()), kNumThreads, CALIBRATION_BOARDS, CALIBRATION_BOARD_SIZE };
+	const uint64_t key = GetImageChecksum(reinterpret_cast<const char*>(parameters), sizeof(parameters));
+	return (0 != key) ? key : 1;
+}
+
+// Query::TraverseBoard() and Query::TraverseCall() (copy mode, so including pruning) but all it does is count visits.
+static void CalibrationTraversal(char* visited, DictionaryNode* node, unsigned width, unsigned height, unsigned iX, unsigned iY, uint64_t& visits)
+{
+	++visits;
+
+	*visited |= kTileVisitedBit;
+
+	for (const auto& neighbour : kNeighbours)
+	{
+		const unsigned nX = iX+neighbour[0], nY = iY+neighbour[1]; // Wraps around if negative
+		if (nX >= width || nY >= height)
+			continue;
+
+		char* next = visited + neighbour[1]*int(width) + neighbour[0];
+		if (*next & kTileVisitedBit)
+			continue;
+
+		if (auto* child = node->GetChildChecked(*next))
+		{
+			CalibrationTraversal(next, child, width, height, nX, nY, visits);
+
+			if (!child->HasChildren())
+				node->RemoveChild(*next);
+		}
+	}
+
+	*visited ^= kTileVisitedBit;
+
+	node->OnWordFound();
+}
+
+// Solves CALIBRATION_BOARDS random boards against the full dictionary, measuring what each two-letter prefix subtree costs,
+// then bin-packs those over the threads (largest first, into the least loaded one) and stores the result in s_partition.
+static void CalibrateSharding(const std::vector<char>& upper, const std::vector<ParsedWord>& words, uint64_t key)
+{
+	// One tree holding it all.
+	LoadDictionaryNode* tree = new LoadDictionaryNode();
+	for (const auto& word : words)
+	{
+		if (true == word.valid)
+			AddWordToTree(tree, upper.data() + word.offset, word.length, 0, 0); // Whether there's a word is all that matters
+	}
+
+	const size_t numNodes = s_threadInfo[0].nodes;
+	s_threadInfo.assign(kNumThreads, ThreadInfo()); // Counted as thread 0's
+
+	const size_t poolSize = numNodes*sizeof(DictionaryNode);
+	auto* pool = static_cast<DictionaryNode*>(mallocAligned(poolSize, kPageSize));
+	memset(static_cast<void*>(pool), 0, poolSize);
+
+	DictionaryNode* next = pool;
+	DictionaryNode::Flatten(next, tree);
+	delete tree;
+
+	// Traversal prunes, so each board gets a fresh copy.
+	auto* copy = static_cast<DictionaryNode*>(mallocAligned(poolSize, kPageSize));
+
+	constexpr unsigned kNumPrefixes = kAlphaRange*kAlphaRange;
+	std::vector<uint64_t> visits(kNumPrefixes, 0);
+
+	constexpr unsigned size = CALIBRATION_BOARD_SIZE;
+	std::vector<char> board(size*size);
+
+	// Own generator & seed: same partition every time, and the caller's sequence is left alone.
+	tinymt32_t genState;
+	tinymt32_init(&genState, 0xbadf00d);
+
+	for (unsigned iBoard = 0; iBoard < CALIBRATION_BOARDS; ++iBoard)
+	{
+		for (auto& tile : board)
+			tile = char(USE_EXTRA_INDEX + tinymt32_generate_uint32(&genState) % kAlphaRange);
+
+		memcpy(static_cast<void*>(copy), pool, poolSize);
+
+		for (unsigned iY = 0; iY < size; ++iY)
+		{
+			for (unsigned iX = 0; iX < size; ++iX)
+			{
+				char* visited = &board[iY*size + iX];
+				const unsigned first = *visited - USE_EXTRA_INDEX;
+
+				auto* child = copy->GetChildChecked(*visited);
+				if (nullptr == child)
+					continue;
+
+				*visited |= kTileVisitedBit;
+
+				// Same as CalibrationTraversal(), but keeping track of which prefix it's in.
+				for (const auto& neighbour : kNeighbours)
+				{
+					const unsigned nX = iX+neighbour[0], nY = iY+neighbour[1];
+					if (nX >= size || nY >= size)
+						continue;
+
+					char* next = &board[nY*size + nX];
+					if (*next & kTileVisitedBit)
+						continue;
+
+					if (auto* grandChild = child->GetChildChecked(*next))
+					{
+						const unsigned prefix = first*kAlphaRange + (*next-USE_EXTRA_INDEX);
+						CalibrationTraversal(next, grandChild, size, size, nX, nY, visits[prefix]);
+
+						if (!grandChild->HasChildren())
+							child->RemoveChild(*next);
+					}
+				}
+
+				*visited ^= kTileVisitedBit;
+			}
+		}
+	}
+
+	// Cost per query: visits (a handful of neighbours and likely a cache miss each), plus copying the nodes unless they're shared.
+	std::vector<uint64_t> costs(kNumPrefixes, 0);
+	for (unsigned first = 0; first < kAlphaRange; ++first)
+	{
+		if (!pool->HasChild(first+USE_EXTRA_INDEX))
+			continue;
+
+		const DictionaryNode* child = pool->GetChild(first+USE_EXTRA_INDEX);
+		for (unsigned second = 0; second < kAlphaRange; ++second)
+		{
+			if (!child->HasChild(second+USE_EXTRA_INDEX))
+				continue;
+
+			const unsigned prefix = first*kAlphaRange + second;
+			costs[prefix] = 1 + 8*visits[prefix]/CALIBRATION_BOARDS;
+
+#if !defined(NON_DESTRUCTIVE_TRAVERSAL)
+			costs[prefix] += CountNodes(child->GetChild(second+USE_EXTRA_INDEX));
+#endif
+		}
+	}
+
+	freeAligned(copy);
+	freeAligned(pool);
+
+	std::vector<unsigned> order;
+	for (unsigned prefix = 0; prefix < kNumPrefixes; ++prefix)
+	{
+		if (0 != costs[prefix])
+			order.push_back(prefix);
+	}
+
+	std::sort(order.begin(), order.end(), [&costs](unsigned a, unsigned b) { return costs[a] > costs[b] || (costs[a] == costs[b] && a < b); });
+
+	std::vector<uint64_t> loads(kNumThreads, 0);
+	s_partition.assign(kNumPrefixes, kNoShard);
+
+	for (const unsigned prefix : order)
+	{
+		const size_t iThread = std::min_element(loads.begin(), loads.end()) - loads.begin();
+		s_partition[prefix] = uint16_t(iThread);
+		loads[iThread] += costs[prefix];
+	}
+
+	s_partitionKey = key;
+
+	debug_print("Calibrated %zu prefixes over %zu threads, cost ranging from %llu to %llu.\n", order.size(), kNumThreads, 
+		(unsigned long long) *std::min_element(loads.begin(), loads.end()), (unsigned long long) *std::max_element(loads.begin(), loads.end()));
+}
+
+#endif // CALIBRATED_SHARDING
+
+void LoadDictionary(const char* path)
+{
+	// If the dictionary fails to load, you'll be left with an empty dictionary.
+	FreeDictionary();
+	
+	if (nullptr == path)
+		return;
+
+	std::vector<char> upper;
+	std::vector<ParsedWord> words;
+	if (false == ParseDictionary(path, upper, words))
+	{
+		debug_print("Can not open dictionary for read access at: %s\n", path);
+		return;
+	}
+
+#ifdef NED_FLANDERS
+	DictionaryLock lock;
+#endif
+	{
+		for (auto iThread = 0; iThread < kNumThreads; ++iThread)
+			s_threadDicts.push_back(new LoadDictionaryNode()); // Allocated in AddWordToDictionary() for (ever so slightly) better locality
+
+#if defined(CALIBRATED_SHARDING)
+		// Calibrate, unless we already did for this very dictionary (and number of threads).
+		const uint64_t partitionKey = GetPartitionKey(upper);
+		if (partitionKey != s_partitionKey)
+			CalibrateSharding(upper, words, partitionKey);
+
+		for (const auto &word : words)
+		{
+			const char* letters = upper.data() + word.offset;
+
+			if (true == word.valid)
+				AddWordToDictionary(letters, word.length, s_partition[GetWordPrefix(letters)]);
+			else
+				debug_print("Invalid word (length or 'Qu' rule): %.*s\n", int(word.length), letters);
+		}
+#else
+		// Shards aren't partitioned by prefix.
+		s_partition.clear();
+		s_partitionKey = 0;
+
+		// Pathetic attempt at load balancing:
+		const size_t numWords = words.size();
+		size_t wordsPerThread = numWords/kNumThreads;
+		Assert(0 == numWords % kNumThreads);
+		const unsigned maxNumRoots = unsigned(std::ceil(std::log2(kNumThreads)));
+
+		unsigned iThread = 0;
+		for (const auto &word : words)
+		{
+			// Word of any use given the Boggle rules?
+			if (true == word.valid)
+				AddWordToDictionary(upper.data() + word.offset, word.length, iThread);
+			else
+				debug_print("Invalid word (length or 'Qu' rule): %.*s\n", int(word.length), upper.data() + word.offset);
+
+			const unsigned load = unsigned(s_threadInfo[iThread].load);
+			if (load >= wordsPerThread)
+			{
+				const size_t nodes = s_threadInfo[iThread].nodes;
+
+				unsigned curComp = unsigned(nodes)/(1+load);
+				for (unsigned iComp = 0; iComp < kNumThreads; ++iComp)
+				{
+					if (iComp == iThread)
+						continue;
+
+					const size_t compNodes   = s_threadInfo[iComp].nodes;
+					const size_t compLoad    = s_threadInfo[iComp].load;
+//					const size_t compNumBits = GetNumBits(s_threadDicts[iComp]->GetIndexBits());
+
+					if (unsigned(compNodes/(1+compLoad)) < curComp)
+					{
+						iThread = iComp;
+						break;
+					}
+				}
+			}
+			else
+			{
+				const auto numBits = GetNumBits(s_threadDicts[iThread]->GetIndexBits());
+				if (numBits > maxNumRoots)
+				{
+					// This walks a cycle of at most kNumThreads, so give up after that (happens with few threads).
+					unsigned numTries = 0;
+					do
+					{
+						iThread = (iThread-1) % kNumThreads;
+					}
+					while (GetNumBits(s_threadDicts[iThread]->GetIndexBits()) >= maxNumRoots && ++numTries < kNumThreads);
+				}
+			}
+		}
+#endif
+
+#ifdef NED_FLANDERS		 
+		// Check thread load total.
+		size_t count = 0;
+		for (CONST auto& info : s_threadInfo)
+			count += info.load;
+
+		if (count != s_wordCount)
+			debug_print("Thread word count (load) %zu != total word count %zu!", count, s_wordCount);
+#endif
+
+		s_wordTable = s_words.data();
+
+		// Flatten all trees in one go (zeroed, see CompileDictionaryImage()) and let go of them.
+		size_t numNodes = 0;
+		for (const auto& info : s_threadInfo)
+			numNodes += info.nodes;
+
+#if defined(HOT_COLD_NODES)
+		const size_t storageSize = numNodes*(sizeof(DictionaryNode)+sizeof(uint32_t));
+#else
+		const size_t storageSize = numNodes*sizeof(DictionaryNode);
+#endif
+
+		s_poolStorage = static_cast<DictionaryNode*>(mallocAligned(storageSize, kPageSize));
+		memset(static_cast<void*>(s_poolStorage), 0, storageSize);
+
+#if defined(HOT_COLD_NODES)
+		uint32_t* requiredLetters = reinterpret_cast<uint32_t*>(s_poolStorage + numNodes);
+		s_requiredLetters = requiredLetters;
+#endif
+
+		DictionaryNode* next = s_poolStorage;
+		for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+		{
+			s_threadPools.push_back(next);
+#if defined(HOT_COLD_NODES)
+			DictionaryNode::Flatten(next, s_threadDicts[iThread], requiredLetters + (next-s_poolStorage));
+#else
+			DictionaryNode::Flatten(next, s_threadDicts[iThread]);
+#endif
+			Assert(size_t(next-s_threadPools.back()) == s_threadInfo[iThread].nodes);
+
+			delete s_threadDicts[iThread];
+		}
+
+		s_threadDicts.clear();
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		AllocateNodeStates();
+#endif
+
+		CreateWorkers();
+	}
+
+	printf("Dictionary loaded. %zu words, longest being %u characters\n", s_wordCount, s_longestWord);
+}
+
+/*
+	Dictionary image: everything LoadDictionary() builds, flattened, so it can be mapped and used as-is.
+
+	Layout (all of it native, so only portable between identical builds, hence the sizes in the header):
+	- ImageHeader
+	- ThreadInfo[numThreads]
+	- uint16_t[kAlphaRange*kAlphaRange]: s_partition, all kNoShard if not calibrated
+	- Word[wordCount]
+	- Per thread: DictionaryNode[nodes], each pool starting on a node-sized boundary
+	- HOT_COLD_NODES only: uint32_t[nodes of all threads], see s_requiredLetters
+*/
+
+constexpr uint32_t kImageMagic   = 0x4c474f42; // "BOGL"
+constexpr uint32_t kImageVersion = 3;          // Bump if Word, ThreadInfo, DictionaryNode or the layout changes!
+
+constexpr size_t kImagePartitionSize = kAlphaRange*kAlphaRange*sizeof(uint16_t);
+static_assert(0 == kImagePartitionSize % alignof(Word));
+
+struct ImageHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nodeSize;
+	uint32_t wordSize;
+	uint64_t numThreads;
+	uint64_t wordCount;
+	uint64_t longestWord;
+	uint64_t payloadSize;  // Everything past the header
+	uint64_t checksum;     // Of the payload
+	uint64_t partitionKey; // Zero if not calibrated
+};
+
+// Currently mapped image, if any.
+static const void* s_image = nullptr;
+static size_t s_imageSize = 0;
+
+BOGGLE_INLINE static size_t AlignImageOffset(size_t offset)
+{
+	return (offset + sizeof(DictionaryNode)-1) & ~(sizeof(DictionaryNode)-1);
+}
+
+// Offset of each thread's pool relative to the payload, and the payload size as last element.
+static std::vector<size_t> GetImagePoolOffsets(const ThreadInfo* threadInfo, size_t numThreads, size_t wordCount)
+{
+	std::vector<size_t> offsets(numThreads+1);
+
+	// Pools are aligned relative to the file, not the payload.
+	size_t offset = AlignImageOffset(sizeof(ImageHeader) + numThreads*sizeof(ThreadInfo) + kImagePartitionSize + wordCount*sizeof(Word));
+	for (size_t iThread = 0; iThread < numThreads; ++iThread)
+	{
+		offsets[iThread] = offset - sizeof(ImageHeader);
+		offset += threadInfo[iThread].nodes*sizeof(DictionaryNode);
+	}
+
+#if defined(HOT_COLD_NODES)
+	for (size_t iThread = 0; iThread < numThreads; ++iThread)
+		offset += threadInfo[iThread].nodes*sizeof(uint32_t);
+#endif
+
+	offsets[numThreads] = offset - sizeof(ImageHeader);
+	return offsets;
+}
+
+// FNV-1a, 64 bits at a time; it only needs to catch truncated or otherwise damaged files.
+static uint64_t GetImageChecksum(const char* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+
+	size_t iByte = 0;
+	for (; iByte+sizeof(uint64_t) <= size; iByte += sizeof(uint64_t))
+	{
+		uint64_t value;
+		memcpy(&value, data+iByte, sizeof(uint64_t));
+		hash = (hash^value) * 0x100000001b3;
+	}
+
+	for (; iByte < size; ++iByte)
+		hash = (hash^uint8_t(data[iByte])) * 0x100000001b3;
+
+	return hash;
+}
+
+bool CompileDictionaryImage(const char* path, const char* imagePath)
+{
+#if defined(LOUDS_TRIE)
+	// An image is mostly pools, which BuildLoudsTries() lets go of, so don't bother loading the dictionary at all.
+	printf("CompileDictionaryImage() isn't supported with LOUDS_TRIE.\n");
+	return false;
+#endif
+
+	LoadDictionary(path);
+
+	if (0 == s_wordCount || nullptr == imagePath)
+		return false;
+
+#ifdef NED_FLANDERS
+	DictionaryLock lock;
+#endif
+	{
+		const std::vector<size_t> offsets = GetImagePoolOffsets(s_threadInfo.data(), kNumThreads, s_wordCount);
+		const size_t payloadSize = offsets[kNumThreads];
+
+		// Zeroed, so unused child slots and padding don't make the checksum a lottery.
+		std::vector<char> payload(payloadSize, 0);
+		memcpy(payload.data(), s_threadInfo.data(), kNumThreads*sizeof(ThreadInfo));
+
+		// Saved along, so loading the image (and then the same dictionary) doesn't mean calibrating again.
+		std::vector<uint16_t> partition = s_partition;
+		partition.resize(kAlphaRange*kAlphaRange, kNoShard);
+		memcpy(payload.data() + kNumThreads*sizeof(ThreadInfo), partition.data(), kImagePartitionSize);
+
+		memcpy(payload.data() + kNumThreads*sizeof(ThreadInfo) + kImagePartitionSize, s_wordTable, s_wordCount*sizeof(Word));
+
+		size_t numNodes = 0;
+		for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+		{
+			memcpy(payload.data() + offsets[iThread], s_threadPools[iThread], s_threadInfo[iThread].nodes*sizeof(DictionaryNode));
+			numNodes += s_threadInfo[iThread].nodes;
+		}
+
+#if defined(HOT_COLD_NODES)
+		memcpy(payload.data() + offsets[0] + numNodes*sizeof(DictionaryNode), s_requiredLetters, numNodes*sizeof(uint32_t));
+#endif
+
+		ImageHeader header = {};
+		header.magic        = kImageMagic;
+		header.version      = kImageVersion;
+		header.nodeSize     = sizeof(DictionaryNode);
+		header.wordSize     = sizeof(Word);
+		header.numThreads   = kNumThreads;
+		header.wordCount    = s_wordCount;
+		header.longestWord  = s_longestWord;
+		header.payloadSize  = payloadSize;
+		header.checksum     = GetImageChecksum(payload.data(), payloadSize);
+		header.partitionKey = s_partition.empty() ? 0 : s_partitionKey;
+
+		FILE* file = fopen(imagePath, "wb");
+		if (nullptr == file)
+		{
+			debug_print("Can not open dictionary image for write access at: %s\n", imagePath);
+			return false;
+		}
+
+		const bool written = 
+			1 == fwrite(&header, sizeof(ImageHeader), 1, file) &&
+			1 == fwrite(payload.data(), payloadSize, 1, file);
+
+		if (0 != fclose(file) || false == written)
+		{
+			debug_print("Failed to write dictionary image: %s\n", imagePath);
+			remove(imagePath);
+			return false;
+		}
+	}
+
+	printf("Dictionary image compiled: %s\n", imagePath);
+
+	return true;
+}
+
+bool LoadDictionaryImage(const char* imagePath)
+{
+	// If the image fails to load, you'll be left with an empty dictionary.
+	FreeDictionary();
+
+	if (nullptr == imagePath)
+		return false;
+
+	size_t size;
+	const char* image = static_cast<const char*>(mapFile(imagePath, &size));
+	if (nullptr == image)
+	{
+		debug_print("Can not map dictionary image at: %s\n", imagePath);
+		return false;
+	}
+
+	ImageHeader header = {};
+	if (size >= sizeof(ImageHeader))
+		memcpy(&header, image, sizeof(ImageHeader));
+
+	const char* payload = image + sizeof(ImageHeader);
+
+	// The thread count is part of the layout, so an image only fits the kind of machine it was compiled on.
+	bool valid = 
+		kImageMagic == header.magic && kImageVersion == header.version &&
+		sizeof(DictionaryNode) == header.nodeSize && sizeof(Word) == header.wordSize &&
+		kNumThreads == header.numThreads &&
+		size - sizeof(ImageHeader) == header.payloadSize &&
+		header.payloadSize > kNumThreads*sizeof(ThreadInfo) + kImagePartitionSize &&
+		header.checksum == GetImageChecksum(payload, header.payloadSize);
+
+	if (true == valid)
+	{
+		const ThreadInfo* threadInfo = reinterpret_cast<const ThreadInfo*>(payload);
+		valid = header.payloadSize == GetImagePoolOffsets(threadInfo, kNumThreads, size_t(header.wordCount))[kNumThreads];
+	}
+
+	if (false == valid)
+	{
+		debug_print("Invalid (or foreign) dictionary image: %s\n", imagePath);
+		unmapFile(image, size);
+		return false;
+	}
+
+#ifdef NED_FLANDERS
+	DictionaryLock lock;
+#endif
+	{
+		s_image = image;
+		s_imageSize = size;
+
+		const ThreadInfo* threadInfo = reinterpret_cast<const ThreadInfo*>(payload);
+		s_threadInfo.assign(threadInfo, threadInfo + kNumThreads);
+
+		const std::vector<size_t> offsets = GetImagePoolOffsets(threadInfo, kNumThreads, size_t(header.wordCount));
+		size_t numNodes = 0;
+		for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+		{
+			s_threadPools.push_back(reinterpret_cast<const DictionaryNode*>(payload + offsets[iThread]));
+			numNodes += threadInfo[iThread].nodes;
+		}
+
+#if defined(HOT_COLD_NODES)
+		s_requiredLetters = reinterpret_cast<const uint32_t*>(s_threadPools[0] + numNodes);
+#endif
+
+		const uint16_t* partition = reinterpret_cast<const uint16_t*>(payload + kNumThreads*sizeof(ThreadInfo));
+		if (0 != header.partitionKey)
+			s_partition.assign(partition, partition + kAlphaRange*kAlphaRange);
+		else
+			s_partition.clear();
+
+		s_partitionKey = header.partitionKey;
+
+		s_wordTable = reinterpret_cast<const Word*>(payload + kNumThreads*sizeof(ThreadInfo) + kImagePartitionSize);
+		s_wordCount = size_t(header.wordCount);
+		s_longestWord = unsigned(header.longestWord);
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		AllocateNodeStates();
+#endif
+
+		CreateWorkers();
+	}
+
+	printf("Dictionary image loaded. %zu words, longest being %u characters\n", s_wordCount, s_longestWord);
+
+	return true;
+}
+
+void FreeDictionary()
+{
+#ifdef NED_FLANDERS
+	DictionaryLock lock;
+#endif
+	{
+		// Workers first, they're tied to this dictionary.
+		DestroyWorkers();
+
+		// Delete per-thread dictionary trees.
+		for (auto* root : s_threadDicts)
+			delete root;
+
+		s_threadDicts.clear();
+
+		// Release pools (or image).
+		s_threadPools.clear();
+#if defined(HOT_COLD_NODES)
+		s_requiredLetters = nullptr;
+#endif
+
+		if (nullptr != s_poolStorage)
+		{
+			freeAligned(s_poolStorage);
+			s_poolStorage = nullptr;
+		}
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		s_threadStates.clear();
+		s_threadEpochs.clear();
+
+		if (nullptr != s_stateStorage)
+		{
+			freeAligned(s_stateStorage);
+			s_stateStorage = nullptr;
+		}
+#endif
+
+		if (nullptr != s_image)
+		{
+			unmapFile(s_image, s_imageSize);
+			s_image = nullptr;
+			s_imageSize = 0;
+		}
+
+		// Reset words & thread information.
+		s_words.clear();
+		s_wordTable = nullptr;
+		s_threadInfo.assign(kNumThreads, ThreadInfo());
+
+		// Reset counters.
+		s_longestWord = 0;
+		s_wordCount = 0;
+	}
+}
+
+bool UsePrefixHash(bool use)
+{
+#if defined(PREFIX_HASH_ENGINE)
+#ifdef NED_FLANDERS
+	DictionaryLock lock;
+#endif
+	{
+		s_usePrefixHash = use;
+
+		// Only kept around while in use; if there's no dictionary yet, CreateWorkers() takes care of it.
+		if (false == use)
+			s_prefixHashes.clear();
+		else if (s_prefixHashes.empty() && false == s_threadPools.empty())
+			BuildPrefixHashes();
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Which letters are on a board and which are next to each other; the same for every thread, so FindWordsBatch() finds
+// them once per board (any query does if it isn't given any).
+class BoardLetters
+{
+public:
+	void Find(const char* sanitized, unsigned width, unsigned height)
+	{
+#if defined(LETTER_HISTOGRAM)
+		CountLetters(sanitized, width, height);
+#endif
+
+#if defined(BIGRAM_MASK)
+		FindBigrams(sanitized, width, height);
+#endif
+
+#if !defined(BOARD_LETTERS)
+		(void) sanitized; (void) width; (void) height;
+#endif
+	}
+
+#if defined(LETTER_HISTOGRAM)
+	// Tiles per letter, and which of them are on the board at all.
+	uint32_t letterCounts[kAlphaRange+USE_EXTRA_INDEX];
+	uint32_t boardLetters;
+#endif
+
+#if defined(BIGRAM_MASK)
+	// All bits set if it switched itself off.
+	uint32_t bigrams[kAlphaRange+USE_EXTRA_INDEX];
+#endif
+
+private:
+#if defined(LETTER_HISTOGRAM)
+	void CountLetters(const char* sanitized, unsigned width, unsigned height);
+#endif
+
+#if defined(BIGRAM_MASK)
+	void FindBigrams(const char* sanitized, unsigned width, unsigned height);
+#endif
+};
+
+// This class contains the actual solver and it's entire context, including a local copy of the dictionary.
+// This means that there will be no problem reloading the dictionary whilst solving, nor will concurrent FindWords()
+// calls cause any fuzz due to globals and such.
+
+// What FindWordsBatch() hands to the workers.
+class Batch
+{
+public:
+	Results* results;
+	const char* const* sanitized; // Null if skipped
+#if defined(NEIGHBOUR_MASKS)
+	const uint32_t* const* neighbourMasks; // Null if none
+#endif
+	const BoardLetters* letters; // Found before running the workers
+	const unsigned* widths;
+	const unsigned* heights;
+	unsigned count;
+	size_t maxGridSize;
+
+	// Where a thread's words for a board end in it's list (s_threadWordsFound), at [iThread*count + iBoard].
+	std::vector<size_t> wordsEnd;
+};
+
+class Query
+{
+public:
+	// Finds the board's letters itself unless they're given (see BoardLetters).
+	Query(Results& results, const char* sanitized, unsigned width, unsigned height, const BoardLetters* letters = nullptr) :
+		m_results(results)
+,		m_sanitized(sanitized)
+,		m_width(width)
+,		m_height(height) 
+	{
+#if defined(BOARD_LETTERS)
+		if (nullptr == letters)
+		{
+			m_ownLetters.Find(sanitized, width, height);
+			letters = &m_ownLetters;
+		}
+
+		m_letters = letters;
+#else
+		(void) letters;
+#endif
+
+#if defined(RELAXED_PREFILTER)
+		if (width*height >= RELAXED_PREFILTER_MIN_SIZE)
+			FindLetterBoards();
+#endif
+	}
+
+	~Query() {}
+
+#if defined(NEIGHBOUR_MASKS)
+	// Optional (see GetNeighbourMasks()).
+	void SetNeighbourMasks(const uint32_t* neighbourMasks)
+	{
+		m_neighbourMasks = neighbourMasks;
+	}
+#endif
+
+	void ExecuteThread(unsigned iThread, std::vector<unsigned>& wordsFound);
+	static void ExecuteBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound);
+
+#if defined(WORK_STEALING)
+	void PrepareTasks(unsigned iThread, std::vector<unsigned>& wordsFound);
+	void ExecuteTasks(unsigned iWorker, std::vector<unsigned>& wordsFound);
+#endif
+
+#if defined(BOARD_PARTITIONING)
+	void ExecuteSquares(unsigned iWorker, std::vector<unsigned>& wordsFound);
+#endif
+
+private:
+	// Everything a thread drags along while traversing.
+	class ThreadContext
+	{
+	public:
+		ThreadContext(std::vector<unsigned>& wordsFound, unsigned pitch) :
+			wordsFound(wordsFound)
+,			pitch(pitch)
+,			neighbours{ 1-int(pitch), -int(pitch), -1-int(pitch), -1, 1, int(pitch)+1, int(pitch), int(pitch)-1 } {}
+
+		std::vector<unsigned>& wordsFound;
+
+		// Offsets to neighbouring tiles in a (padded) grid 'pitch' tiles wide, same order as kNeighbours.
+		const unsigned pitch;
+		const int neighbours[8];
+
+#if defined(LETTER_HISTOGRAM)
+		void SetLetterCounts(const uint32_t* letterCounts)
+		{
+			absentLetters = scarceLetters = 0;
+			for (unsigned letter = 0; letter < kAlphaRange+USE_EXTRA_INDEX; ++letter)
+			{
+				remaining[letter] = letterCounts[letter];
+				if (0 == remaining[letter])
+					absentLetters |= 1 << letter;
+				else if (remaining[letter] < MAX_WORD_LEN)
+					scarceLetters |= 1 << letter;
+			}
+		}
+
+		// Only letters that can run out on a single path are counted (so on large boards, next to none).
+		BOGGLE_INLINE_FORCE void OnVisit(unsigned letter)
+		{
+			if (scarceLetters & (1 << letter))
+			{
+				if (0 == --remaining[letter])
+					absentLetters |= 1 << letter;
+			}
+		}
+
+		BOGGLE_INLINE_FORCE void OnLeave(unsigned letter)
+		{
+			if (scarceLetters & (1 << letter))
+			{
+				if (0 == remaining[letter]++)
+					absentLetters ^= 1 << letter;
+			}
+		}
+
+		// False if it needs a letter that's run out (for now); only touches the node if any has.
+		BOGGLE_INLINE_FORCE bool CanFinish(const DictionaryNode* node) const
+		{
+#if defined(HOT_COLD_NODES)
+			return 0 == absentLetters || 0 == (s_requiredLetters[GetNodeIndex(node)] & absentLetters);
+#else
+			return 0 == absentLetters || 0 == (node->GetRequiredLetters() & absentLetters);
+#endif
+		}
+
+		// Unvisited tiles per letter.
+		uint32_t remaining[kAlphaRange+USE_EXTRA_INDEX];
+		uint32_t absentLetters;
+		uint32_t scarceLetters;
+#endif
+
+#if defined(NODE_SIDE_TABLES)
+		// For arrays that go along with all pools at once (such as s_requiredLetters): 'nodes' is the pool being
+		// traversed (copy or not) of shard 'iThread'.
+		void SetNodes(const DictionaryNode* nodes, unsigned iThread)
+		{
+			this->nodes = nodes;
+			firstNode = size_t(s_threadPools[iThread]-s_threadPools[0]);
+		}
+
+		BOGGLE_INLINE_FORCE size_t GetNodeIndex(const DictionaryNode* node) const
+		{
+			return firstNode + size_t(node-nodes);
+		}
+
+		const DictionaryNode* nodes = nullptr;
+		size_t firstNode = 0;
+#endif
+
+#if defined(GRANDCHILD_TABLES)
+		// Of 'node' (on 'tile'), the grandchildren that could be next to any of it's children nearby, given it's table.
+		BOGGLE_INLINE void PrefetchGrandchildren(const char* tile, const DictionaryNode* node, uint32_t children, const uint32_t* table) const
+		{
+			constexpr unsigned kLetterRange = kAlphaRange+USE_EXTRA_INDEX;
+
+			for (unsigned iNeighbour = 0; iNeighbour < 8; ++iNeighbour)
+			{
+				// Visited tiles (and the border) have the top bit set, so never a child.
+				const char* next = tile + neighbours[iNeighbour];
+				const unsigned letter = uint8_t(*next);
+				if ((letter & kTileVisitedBit) || !(children & (1 << letter)))
+					continue;
+
+				const uint32_t* row = table + letter*kLetterRange;
+				for (unsigned iNext = 0; iNext < 8; ++iNext)
+				{
+					const unsigned second = uint8_t(next[neighbours[iNext]]);
+					if (!(second & kTileVisitedBit) && 0 != row[second])
+						ClosePrefetch(reinterpret_cast<const char*>(node) + row[second]);
+				}
+			}
+		}
+#endif
+
+#if defined(DOUBLE_ARRAY_TRIE)
+		// Per state of 'array', a bit for whether it's word has been found and one for whether there's anything left
+		// to find from it at all (GetStateBitsSize() worth of 'bits', cleared).
+		void SetArray(const DoubleArray& array, uint64_t* bits)
+		{
+			slots = array.slots.data();
+			words = array.words.data();
+			children = array.children.data();
+			found = bits;
+			exhausted = bits + (array.numStates+63)/64;
+		}
+
+		static size_t GetStateBitsSize(const DoubleArray& array)
+		{
+			return 2*((array.numStates+63)/64)*sizeof(uint64_t);
+		}
+
+		BOGGLE_INLINE_FORCE bool IsFound(uint32_t state) const     { return 0 != (found[state >> 6] & (1ull << (state & 63))); }
+		BOGGLE_INLINE_FORCE bool IsExhausted(uint32_t state) const { return 0 != (exhausted[state >> 6] & (1ull << (state & 63))); }
+
+		BOGGLE_INLINE_FORCE void OnFound(uint32_t state)     { found[state >> 6] |= 1ull << (state & 63); }
+		BOGGLE_INLINE_FORCE void OnExhausted(uint32_t state) { exhausted[state >> 6] |= 1ull << (state & 63); }
+
+		const DoubleArraySlot* slots = nullptr;
+		const int32_t* words = nullptr;
+		const uint32_t* children = nullptr;
+		uint64_t* found = nullptr;
+		uint64_t* exhausted = nullptr;
+#endif
+
+#if defined(DAWG_DICTIONARY)
+		// Per rank in 'dawg', a bit for whether that word has been found (GetFoundBitsSize() worth of 'found', cleared).
+		void SetDawg(const Dawg& dawg, uint64_t* found)
+		{
+			dawgNodes = dawg.nodes.data();
+			dawgEdges = dawg.edges.data();
+			dawgWords = dawg.words.data();
+			this->found = found;
+		}
+
+		// One more word than needed, so IsRangeFound() can always read two.
+		static size_t GetFoundBitsSize(const Dawg& dawg)
+		{
+			return (dawg.words.size()/64 + 2)*sizeof(uint64_t);
+		}
+
+		// All of ranks [rank, rank+count) found? Up to 64 only.
+		BOGGLE_INLINE_FORCE bool IsRangeFound(uint32_t rank, uint32_t count) const
+		{
+			Assert(count > 0 && count <= 64);
+
+			const uint64_t* bits = found + (rank >> 6);
+			const unsigned shift = rank & 63;
+			const uint64_t window = (0 == shift) ? bits[0] : bits[0] >> shift | bits[1] << (64-shift);
+			const uint64_t mask = ~0ull >> (64-count);
+			return mask == (window & mask);
+		}
+
+		BOGGLE_INLINE_FORCE bool IsFound(uint32_t rank) const { return 0 != (found[rank >> 6] & (1ull << (rank & 63))); }
+		BOGGLE_INLINE_FORCE void OnFound(uint32_t rank)       { found[rank >> 6] |= 1ull << (rank & 63); }
+
+		const DawgNode* dawgNodes = nullptr;
+		const DawgEdge* dawgEdges = nullptr;
+		const uint32_t* dawgWords = nullptr;
+		uint64_t* found = nullptr;
+#endif
+
+#if defined(LOUDS_TRIE)
+		// Per node of 'louds', a bit for whether it's word has been found and one for whether there's anything left
+		// to find from it at all (GetNodeBitsSize() worth of 'bits', cleared).
+		void SetLouds(const LoudsTrie& louds, uint64_t* bits)
+		{
+			this->louds = &louds;
+			found = bits;
+			dead = bits + GetNodeBitsWords(louds);
+		}
+
+		// One more word each than needed, so IsRangeDead() can always read two.
+		static size_t GetNodeBitsWords(const LoudsTrie& louds)
+		{
+			return louds.numNodes/64 + 2;
+		}
+
+		static size_t GetNodeBitsSize(const LoudsTrie& louds)
+		{
+			return 2*GetNodeBitsWords(louds)*sizeof(uint64_t);
+		}
+
+		// All of nodes [node, node+count) dead? Up to 64 only.
+		BOGGLE_INLINE_FORCE bool IsRangeDead(uint32_t node, unsigned count) const
+		{
+			Assert(count > 0 && count <= 64);
+
+			const uint64_t* bits = dead + (node >> 6);
+			const unsigned shift = node & 63;
+			const uint64_t window = (0 == shift) ? bits[0] : bits[0] >> shift | bits[1] << (64-shift);
+			const uint64_t mask = ~0ull >> (64-count);
+			return mask == (window & mask);
+		}
+
+		BOGGLE_INLINE_FORCE bool IsFound(uint32_t node) const { return 0 != (found[node >> 6] & (1ull << (node & 63))); }
+		BOGGLE_INLINE_FORCE bool IsDead(uint32_t node) const  { return 0 != (dead[node >> 6] & (1ull << (node & 63))); }
+
+		BOGGLE_INLINE_FORCE void OnFound(uint32_t node) { found[node >> 6] |= 1ull << (node & 63); }
+		BOGGLE_INLINE_FORCE void OnDead(uint32_t node)  { dead[node >> 6] |= 1ull << (node & 63); }
+
+		const LoudsTrie* louds = nullptr;
+		uint64_t* found = nullptr;
+		uint64_t* dead = nullptr;
+#endif
+
+#if defined(PREFIX_HASH_ENGINE)
+		// Per slot of 'hash' (and the root), a state: the number of dead prefixes a letter longer, plus flags below.
+		void SetPrefixHash(const PrefixHash& hash, uint8_t* states)
+		{
+			prefixHash = &hash;
+			prefixStates = states;
+		}
+
+		static size_t GetPrefixStatesSize(const PrefixHash& hash)
+		{
+			return hash.numSlots+1;
+		}
+
+		static constexpr uint8_t kPrefixFound        = 0x80;
+		static constexpr uint8_t kPrefixDead         = 0x40;
+		static constexpr uint8_t kPrefixDeadChildren = 0x3f;
+
+		const PrefixHash* prefixHash = nullptr;
+		uint8_t* prefixStates = nullptr;
+#endif
+
+#if defined(PREFIX_TABLE)
+		// This shard's part of s_prefixTable.
+		const uint32_t* prefixTable = nullptr;
+#endif
+
+#if defined(BIGRAM_MASK)
+		// Per letter, the letters next to it anywhere on the board (see BoardLetters::FindBigrams()).
+		const uint32_t* bigrams;
+#endif
+
+#if defined(NEIGHBOUR_MASKS)
+		// Per tile of 'grid', the letters next to it (see GetNeighbourMasks()).
+		void SetNeighbourMasks(const char* grid, const uint32_t* neighbourMasks)
+		{
+			this->grid = grid;
+			this->neighbourMasks = neighbourMasks;
+		}
+
+		const char* grid = nullptr;
+		const uint32_t* neighbourMasks = nullptr;
+#endif
+
+#if defined(BIGRAM_MASK) || defined(NEIGHBOUR_MASKS)
+		// Could any of 'children' (letter bits) be right next to this tile?
+		BOGGLE_INLINE_FORCE bool CanContinue(const char* tile, uint32_t children) const
+		{
+#if defined(BIGRAM_MASK)
+			children &= bigrams[uint8_t(*tile)];
+#endif
+#if defined(NEIGHBOUR_MASKS)
+			if (nullptr != neighbourMasks)
+				children &= neighbourMasks[tile-grid];
+#endif
+			return 0 != children;
+		}
+#endif
+
+#if !defined(NON_DESTRUCTIVE_TRAVERSAL)
+		// If set, every node changed is logged, so the copy can be restored rather than copied all over (see ThreadCopy::Restore()).
+		// That's one entry per word found and one per child removed, so twice the number of nodes at most.
+		BOGGLE_INLINE_FORCE void OnNodeChanged(DictionaryNode* node)
+		{
+			if (nullptr != changed)
+				changed[numChanged++] = node;
+		}
+
+		DictionaryNode** changed = nullptr;
+		size_t numChanged = 0;
+#endif
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		BOGGLE_INLINE_FORCE NodeState& GetState(const DictionaryNode* node) const
+		{
+			return states[node-pool];
+		}
+
+		const DictionaryNode* pool;
+		NodeState* states;
+		uint32_t epoch;
+#endif
+
+#if defined(BOARD_PARTITIONING)
+		// If set, a word only counts for whoever gets to it first (as multiple threads may find it).
+		BOGGLE_INLINE_FORCE bool Claim(unsigned wordIdx)
+		{
+			if (nullptr == found)
+				return true;
+
+			const uint64_t bit = 1ull << (wordIdx & 63);
+			auto& bits = found[wordIdx >> 6];
+			if ((bits.load(std::memory_order_relaxed) & bit) || (bits.fetch_or(bit, std::memory_order_relaxed) & bit))
+				return false;
+
+			numFound->fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		std::atomic<uint64_t>* found = nullptr;
+		std::atomic<size_t>* numFound = nullptr;
+#endif
+	};
+
+public:
+
+	void Execute()
+	{
+//		debug_printf("Query::Execute(...) for %zu threads!\n", kNumThreads);
+
+#if defined(NED_FLANDERS)
+		// Just in case another Execute() call is made on the same context: avoid leaking.
+		FreeWords(m_results);
+
+		// Bit of a step back from what it was, but as I'm picking words out of the global list now..
+		DictionaryLock dictLock;
+		{
+#endif
+			unsigned Count = 0, Score = 0;
+
+			// I'll be copying pointers, plain and simple, but not the safest given the API.
+			m_results.Words = static_cast<char**>(mallocAligned(s_wordCount*sizeof(char*), kAlignTo));
+			char** words_cstr = const_cast<char**>(m_results.Words); 
+
+#if defined(NED_FLANDERS) // WIP!
+			m_reqStrBufSize = 0;
+#endif
+
+#if defined(BOARD_PARTITIONING)
+			if (m_width*m_height >= BOARD_PARTITION_MIN_SIZE)
+			{
+				// Squares are handed out first come, first served.
+				m_found = std::make_unique<std::atomic<uint64_t>[]>((s_wordCount+63)/64);
+				m_numFound = 0;
+				m_nextSquare = 0;
+
+				s_workerPool->Run([](void* query, unsigned iWorker) 
+				{ 
+					static_cast<Query*>(query)->ExecuteSquares(iWorker, s_threadWordsFound[iWorker]); 
+				}, this);
+			}
+			else
+#endif
+			{
+#if defined(WORK_STEALING)
+				ScheduleTasks();
+
+				// Each worker copies it's own shard first, so all of them are in place before any task gets stolen.
+				s_workerPool->Run([](void* query, unsigned iThread) 
+				{ 
+					static_cast<Query*>(query)->PrepareTasks(iThread, s_threadWordsFound[iThread]); 
+				}, this);
+
+				s_workerPool->Run([](void* query, unsigned iWorker) 
+				{ 
+					static_cast<Query*>(query)->ExecuteTasks(iWorker, s_threadWordsFound[iWorker]); 
+				}, this);
+#else
+				s_workerPool->Run([](void* query, unsigned iThread) 
+				{ 
+					static_cast<Query*>(query)->ExecuteThread(iThread, s_threadWordsFound[iThread]); 
+				}, this);
+#endif
+			}
+
+			// Gather on the calling thread (used to be written from within the parallel loop, racing on the counters).
+			for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+			{
+				const auto& wordsFound = s_threadWordsFound[iThread];
+
+				for (const auto wordIdx : wordsFound)
+				{
+					const auto& word = s_wordTable[wordIdx];
+					
+					++Count;
+					Score += unsigned(word.score);
+
+#if defined(STREAM_WRITES)
+					_mm_stream_si64((long long*) &(*words_cstr++), reinterpret_cast<long long>(word.word));
+//					_mm_stream_si64((long long*) &(*words_cstr++), reinterpret_cast<long long>(word.word.c_str()));
+	#else
+					*words_cstr++ = const_cast<char*>(word.word);
+//					*words_cstr++ = const_cast<char*>(word.word.c_str());
+	#endif
+				}
+				
+				debug_print("Thread %u completed with %zu words.\n", iThread, wordsFound.size());
+			}
+			
+			m_results.Count = Count;
+			m_results.Score = Score;
+
+#if defined(NED_FLANDERS)
+		}
+#endif
+	}
+
+private:
+	void Traverse(ThreadContext& context, DictionaryNode* root, char* visited);
+
+#if defined(DAWG_DICTIONARY)
+	void ExecuteDawgThread(unsigned iThread, std::vector<unsigned>& wordsFound);
+	static void ExecuteDawgBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound);
+
+	void TraverseDawg(ThreadContext& context, char* visited);
+	void TraverseDawg(ThreadContext& context, char* visited, uint32_t node, uint32_t rank);
+#endif
+
+#if defined(PREFIX_HASH_ENGINE)
+	void ExecutePrefixHashThread(unsigned iThread, std::vector<unsigned>& wordsFound);
+	static void ExecutePrefixHashBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound);
+
+	void TraversePrefixHash(ThreadContext& context, char* visited);
+	void TraversePrefixHash(ThreadContext& context, char* visited, uint32_t slot);
+#endif
+
+#if defined(LOUDS_TRIE)
+	void ExecuteLoudsThread(unsigned iThread, std::vector<unsigned>& wordsFound);
+	static void ExecuteLoudsBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound);
+
+	void TraverseLouds(ThreadContext& context, char* visited);
+	void TraverseLouds(ThreadContext& context, char* visited, uint32_t node);
+#endif
+
+#if defined(DOUBLE_ARRAY_TRIE)
+	void ExecuteArrayThread(unsigned iThread, std::vector<unsigned>& wordsFound);
+	static void ExecuteArrayBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound);
+
+	void TraverseArray(ThreadContext& context, char* visited);
+	void TraverseArray(ThreadContext& context, char* visited, uint32_t state);
+#endif
+
+	DictionaryNode* PrepareThread(unsigned iThread, std::vector<unsigned>& wordsFound, char*& visited);
+	void FinishThread(unsigned iThread, std::vector<unsigned>& wordsFound);
+
+#if defined(WORK_STEALING)
+	void ScheduleTasks();
+	void ExecuteTask(const Task& task, char* visited, std::vector<unsigned>& wordsFound);
+#endif
+
+#if defined(DEBUG_STATS)
+	void BOGGLE_INLINE_FORCE TraverseCall(ThreadContext& context, char* visited, DictionaryNode* node, uint8_t depth);
+	void BOGGLE_INLINE TraverseBoard(ThreadContext& context, char* visited, DictionaryNode* node, uint8_t depth);
+#else
+	void BOGGLE_INLINE_FORCE TraverseCall(ThreadContext& context, char* visited, DictionaryNode* node);
+	void BOGGLE_INLINE TraverseBoard(ThreadContext& context, char* visited, DictionaryNode* node);
+#endif
+
+#if defined(RADIX_CHAINS)
+#if defined(DEBUG_STATS)
+	bool FollowChain(ThreadContext& context, char* visited, DictionaryNode* end, uint32_t letters, unsigned length, uint8_t depth);
+#else
+	bool FollowChain(ThreadContext& context, char* visited, DictionaryNode* end, uint32_t letters, unsigned length);
+#endif
+#endif
+
+#if defined(ITERATIVE_TRAVERSAL)
+	// One per letter on the way down.
+	class TraversalFrame
+	{
+	public:
+		char* visited;
+		DictionaryNode* node;
+		int32_t wordIdx;
+		unsigned direction; // Next neighbour to try (see kNeighbours)
+	};
+#endif
+
+	Results& m_results;
+	const char* m_sanitized;
+	const unsigned m_width, m_height;
+
+#if defined(BOARD_LETTERS)
+	BoardLetters m_ownLetters; // Unless given
+	const BoardLetters* m_letters;
+#endif
+
+#if defined(NEIGHBOUR_MASKS)
+	const uint32_t* m_neighbourMasks = nullptr;
+#endif
+
+#if defined(RELAXED_PREFILTER)
+	// Where a thread's Prefilter() keeps it's sets (see GetPrefilterScratchSize()).
+	class PrefilterScratch
+	{
+	public:
+		uint64_t* row;    // In between (bitsets)
+		uint64_t* marked; // Tiles seen (lists)
+		uint64_t* level;  // This level's sets, the next level's follow
+	};
+
+	void FindLetterBoards();
+	void Prefilter(ThreadContext& context, DictionaryNode* root, uint64_t* scratch);
+	bool Prefilter(ThreadContext& context, DictionaryNode* node, const uint64_t* tiles, PrefilterScratch scratch);
+	bool Prefilter(ThreadContext& context, DictionaryNode* node, const uint32_t* tiles, unsigned numTiles, PrefilterScratch scratch);
+	BOGGLE_INLINE_FORCE bool OnPrefiltered(ThreadContext& context, DictionaryNode* node, unsigned children, unsigned alive);
+
+	uint64_t* GetLetterBoard(unsigned letter)
+	{
+		return &m_letterBoards[letter*m_boardPitch + m_boardGuard];
+	}
+
+	// Per letter, a bit per (padded) tile holding it: m_boardWords, with m_boardGuard zeroes either side to make
+	// m_boardPitch. None if the board is too small to bother.
+	std::vector<uint64_t> m_letterBoards;
+	size_t m_boardWords = 0;
+	size_t m_boardGuard = 0;
+	size_t m_boardPitch = 0;
+	unsigned m_listSize = 0;
+#endif
+
+#if defined(NED_FLANDERS)
+	size_t m_reqStrBufSize;
+#endif
+
+#if defined(DEBUG_STATS)
+	unsigned m_maxDepth;
+#endif
+
+#if defined(WORK_STEALING)
+	std::vector<Task> m_tasks;
+	std::vector<DictionaryNode*> m_threadRoots;
+	std::vector<char*> m_threadGrids;
+
+	// Tile offsets sorted by letter: those holding letter L are [m_letterTiles[L], m_letterTiles[L+1]).
+	unsigned* m_tiles;
+	unsigned m_letterTiles[kAlphaRange+USE_EXTRA_INDEX+1];
+#endif
+
+#if defined(BOARD_PARTITIONING)
+	std::unique_ptr<std::atomic<uint64_t>[]> m_found; // A bit per word
+	std::atomic<size_t> m_numFound;
+	std::atomic<unsigned> m_nextSquare;
+#endif
+};
+
+#if defined(LETTER_HISTOGRAM)
+
+void BoardLetters::CountLetters(const char* sanitized, unsigned width, unsigned height)
+{
+	memset(letterCounts, 0, sizeof(letterCounts));
+
+	const size_t gridSize = GetPaddedGridSize(width, height);
+	for (size_t index = 0; index < gridSize; ++index)
+	{
+		const unsigned letter = uint8_t(sanitized[index]);
+		if (letter < kAlphaRange+USE_EXTRA_INDEX) // Not the border
+			++letterCounts[letter];
+	}
+
+	boardLetters = 0;
+	for (unsigned letter = 0; letter < kAlphaRange+USE_EXTRA_INDEX; ++letter)
+	{
+		if (0 != letterCounts[letter])
+			boardLetters |= 1 << letter;
+	}
+}
+
+#endif
+
+#if defined(BIGRAM_MASK) || defined(NEIGHBOUR_MASKS) || defined(SIMD_NEIGHBOURS)
+
+// 1 << letter for 4 (32-bit) tiles at once (0 for anything else, such as the border): a float's exponent does the shifting.
+BOGGLE_INLINE_FORCE static __m128i GetLetterBits(__m128i letters)
+{
+	const __m128i bits = _mm_cvttps_epi32(_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(letters, _mm_set1_epi32(127)), 23)));
+	return _mm_and_si128(bits, _mm_cmplt_epi32(letters, _mm_set1_epi32(kAlphaRange+USE_EXTRA_INDEX)));
+}
+
+BOGGLE_INLINE_FORCE static __m128i GetLetterBits(const char* tiles)
+{
+	int32_t packed;
+	memcpy(&packed, tiles, sizeof(packed));
+
+	const __m128i zero = _mm_setzero_si128();
+	return GetLetterBits(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero));
+}
+
+#endif
+
+#if defined(SIMD_NEIGHBOURS)
+
+// The 3x4 tiles the kernel looks at: 'visited' plus, per row, kNeighbourRows[row]*pitch + column - 1 - (row == 2);
+// the bottom row starts a tile earlier so that we never read past the end of the padded grid (the last interior
+// tile is 'pitch'+1 tiles away from it). Bits 0-2, 4, 6, 9-11 are the 8 neighbours (see kNeighbourBits).
+constexpr int kNeighbourRows[3] = { -1, 0, 1 };
+constexpr unsigned kNeighbourBits = 0xe57;
+
+BOGGLE_INLINE_FORCE static int GetNeighbourOffset(unsigned iBit, unsigned pitch)
+{
+	const unsigned row = iBit >> 2;
+	return kNeighbourRows[row]*int(pitch) + int(iBit & 3) - 1 - (2 == row);
+}
+
+BOGGLE_INLINE_FORCE static uint32_t LoadNeighbourRow(const char* tiles)
+{
+	uint32_t packed;
+	memcpy(&packed, tiles, sizeof(packed));
+	return packed;
+}
+
+#if defined(_WIN32)
+	#define BOGGLE_TARGET(isa) // Any function may use any intrinsic.
+#else
+	// Lets a function use 'isa' whatever the rest is compiled for, so it must only be called if the CPU has it.
+	#define BOGGLE_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// Of the 8 neighbours of 'tile', those that are unvisited (so not the border either) and one of 'children' (letter bits),
+// as bits (see GetNeighbourOffset()).
+static unsigned GetMatchingNeighboursSSE2(const char* tile, unsigned pitch, uint32_t children)
+{
+	const uint32_t above = LoadNeighbourRow(tile-pitch-1);
+	const uint32_t row   = LoadNeighbourRow(tile-1);
+	const uint32_t below = LoadNeighbourRow(tile+pitch-2);
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask = _mm_set1_epi32(int(children));
+	const __m128i upper = _mm_unpacklo_epi8(_mm_setr_epi32(int(above), int(row), 0, 0), zero);
+	const __m128i lower = _mm_unpacklo_epi8(_mm_cvtsi32_si128(int(below)), zero);
+
+	const __m128i aboveBits = _mm_and_si128(GetLetterBits(_mm_unpacklo_epi16(upper, zero)), mask);
+	const __m128i rowBits   = _mm_and_si128(GetLetterBits(_mm_unpackhi_epi16(upper, zero)), mask);
+	const __m128i belowBits = _mm_and_si128(GetLetterBits(_mm_unpacklo_epi16(lower, zero)), mask);
+
+	const unsigned misses =
+		  _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(aboveBits, zero)))
+		| _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(rowBits, zero))) << 4
+		| _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(belowBits, zero))) << 8;
+
+	return ~misses & kNeighbourBits;
+}
+
+#if defined(FOR_INTEL)
+
+// Same, with a variable shift per tile for the top 2 rows.
+BOGGLE_TARGET("avx2") static unsigned GetMatchingNeighboursAVX2(const char* tile, unsigned pitch, uint32_t children)
+{
+	const uint32_t above = LoadNeighbourRow(tile-pitch-1);
+	const uint32_t row   = LoadNeighbourRow(tile-1);
+	const uint32_t below = LoadNeighbourRow(tile+pitch-2);
+
+	const __m256i letters = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(int64_t(above) | int64_t(row) << 32));
+	const __m256i bits = _mm256_and_si256(_mm256_sllv_epi32(_mm256_set1_epi32(1), letters), _mm256_set1_epi32(int(children)));
+	const unsigned misses = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(bits, _mm256_setzero_si256())));
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i belowBits = _mm_and_si128(GetLetterBits(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(below)), zero), zero)), _mm_set1_epi32(int(children)));
+	const unsigned belowMisses = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(belowBits, zero)));
+
+	return ~(misses | belowMisses << 8) & kNeighbourBits;
+}
+
+// Same, all 3 rows at once.
+BOGGLE_TARGET("avx512f") static unsigned GetMatchingNeighboursAVX512(const char* tile, unsigned pitch, uint32_t children)
+{
+	const uint32_t above = LoadNeighbourRow(tile-pitch-1);
+	const uint32_t row   = LoadNeighbourRow(tile-1);
+	const uint32_t below = LoadNeighbourRow(tile+pitch-2);
+
+	// Shifts of 32 or more yield 0, which takes care of visited tiles. Zero-masked, as GCC 12 warns about the undefined
+	// lanes the plain versions start from.
+	const __m512i letters = _mm512_maskz_cvtepu8_epi32(0xffff, _mm_setr_epi32(int(above), int(row), int(below), 0));
+	const __m512i bits = _mm512_maskz_sllv_epi32(0xffff, _mm512_set1_epi32(1), letters);
+	return _mm512_test_epi32_mask(bits, _mm512_set1_epi32(int(children))) & kNeighbourBits;
+}
+
+#endif
+
+#if defined(_DEBUG) || defined(ASSERTIONS)
+
+// What GetMatchingNeighbours() should come up with.
+static unsigned GetMatchingNeighboursScalar(const char* tile, unsigned pitch, uint32_t children)
+{
+	unsigned matches = 0;
+	for (unsigned iBit = 0; iBit < 12; ++iBit)
+	{
+		const unsigned letter = uint8_t(tile[GetNeighbourOffset(iBit, pitch)]);
+		if ((kNeighbourBits & (1 << iBit)) && letter < kAlphaRange+USE_EXTRA_INDEX && (children & (1 << letter)))
+			matches |= 1 << iBit;
+	}
+
+	return matches;
+}
+
+#endif
+
+// What TraverseBoard() finds the neighbours that may follow with; none means it looks at all 8.
+enum class NeighbourKernel
+{
+	kNone,
+	kSSE2,
+	kAVX2,
+	kAVX512
+};
+
+// Names (as UseNeighbourKernel() takes them) by NeighbourKernel.
+static const char* const kNeighbourKernelNames[] = { "none", "sse2", "avx2", "avx512f" };
+
+static bool CanRunNeighbourKernel(NeighbourKernel kernel)
+{
+#if defined(FOR_INTEL) && !defined(_WIN32)
+	__builtin_cpu_init(); // We may be called before main().
+#endif
+
+	switch (kernel)
+	{
+	case NeighbourKernel::kNone:
+		return true;
+
+#if defined(FOR_INTEL)
+	#if defined(_WIN32)
+	case NeighbourKernel::kSSE2:
+		return IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+	case NeighbourKernel::kAVX2:
+		return IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE);
+	case NeighbourKernel::kAVX512:
+		return IsProcessorFeaturePresent(PF_AVX512F_INSTRUCTIONS_AVAILABLE);
+	#else
+	case NeighbourKernel::kSSE2:
+		return __builtin_cpu_supports("sse2");
+	case NeighbourKernel::kAVX2:
+		return __builtin_cpu_supports("avx2");
+	case NeighbourKernel::kAVX512:
+		return __builtin_cpu_supports("avx512f");
+	#endif
+#else
+	case NeighbourKernel::kSSE2:
+		return true; // NEON (sse2neon)
+#endif
+
+	default:
+		return false;
+	}
+}
+
+// The widest this CPU can run.
+static NeighbourKernel GetBestNeighbourKernel()
+{
+	for (const auto kernel : { NeighbourKernel::kAVX512, NeighbourKernel::kAVX2, NeighbourKernel::kSSE2 })
+	{
+		if (true == CanRunNeighbourKernel(kernel))
+			return kernel;
+	}
+
+	return NeighbourKernel::kNone;
+}
+
+// Picked once at startup (see UseNeighbourKernel()).
+static NeighbourKernel s_neighbourKernel = GetBestNeighbourKernel();
+
+BOGGLE_INLINE_FORCE static unsigned GetMatchingNeighbours(NeighbourKernel kernel, const char* tile, unsigned pitch, uint32_t children)
+{
+#if defined(FOR_INTEL)
+	if (NeighbourKernel::kAVX512 == kernel)
+		return GetMatchingNeighboursAVX512(tile, pitch, children);
+	else if (NeighbourKernel::kAVX2 == kernel)
+		return GetMatchingNeighboursAVX2(tile, pitch, children);
+#endif
+
+	return GetMatchingNeighboursSSE2(tile, pitch, children);
+}
+
+#endif
+
+bool UseNeighbourKernel(const char* name)
+{
+#if defined(SIMD_NEIGHBOURS) && !defined(ITERATIVE_TRAVERSAL)
+	if (nullptr == name)
+	{
+		s_neighbourKernel = GetBestNeighbourKernel();
+		return true;
+	}
+
+	for (unsigned iKernel = 0; iKernel < sizeof(kNeighbourKernelNames)/sizeof(kNeighbourKernelNames[0]); ++iKernel)
+	{
+		const auto kernel = NeighbourKernel(iKernel);
+		if (0 == strcmp(name, kNeighbourKernelNames[iKernel]) && true == CanRunNeighbourKernel(kernel))
+		{
+			s_neighbourKernel = kernel;
+			return true;
+		}
+	}
+
+	return false;
+#else
+	(void) name;
+	return false;
+#endif
+}
+
+#if defined(BIGRAM_MASK)
+
+void BoardLetters::FindBigrams(const char* sanitized, unsigned width, unsigned height)
+{
+	constexpr unsigned kLetterRange = kAlphaRange+USE_EXTRA_INDEX;
+
+	memset(bigrams, 0, sizeof(bigrams));
+
+	const int pitch = int(width+2);
+	const int neighbours[8] = { 1-pitch, -pitch, -1-pitch, -1, 1, pitch+1, pitch, pitch-1 };
+
+	uint32_t boardLetters = 0;
+
+	for (unsigned iY = 1; iY <= height; ++iY)
+	{
+		const char* row = sanitized + size_t(iY)*pitch;
+
+		// 4 tiles at a time (as long as the neighbours stay on the board), letters next to each of them OR'd together.
+		unsigned iX = 1;
+		for (; iX+3 <= width; iX += 4)
+		{
+			__m128i adjacent = GetLetterBits(row+iX+neighbours[0]);
+			for (unsigned iNeighbour = 1; iNeighbour < 8; ++iNeighbour)
+				adjacent = _mm_or_si128(adjacent, GetLetterBits(row+iX+neighbours[iNeighbour]));
+
+			alignas(16) uint32_t lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), adjacent);
+
+			for (unsigned iLane = 0; iLane < 4; ++iLane)
+			{
+				const unsigned letter = uint8_t(row[iX+iLane]);
+				if (letter < kLetterRange)
+				{
+					bigrams[letter] |= lanes[iLane];
+					boardLetters |= 1 << letter;
+				}
+			}
+		}
+
+		for (; iX <= width; ++iX)
+		{
+			const unsigned letter = uint8_t(row[iX]);
+			if (letter >= kLetterRange)
+				continue;
+
+			for (const int offset : neighbours)
+			{
+				const unsigned neighbour = uint8_t(row[int(iX)+offset]);
+				if (neighbour < kLetterRange)
+					bigrams[letter] |= 1 << neighbour;
+			}
+
+			boardLetters |= 1 << letter;
+		}
+
+		// Pretty much everything next to everything? Then it's not worth it (checked every so often).
+		if (0 == (iY & 7) || height == iY)
+		{
+			unsigned numPairs = 0;
+			for (unsigned letter = 0; letter < kLetterRange; ++letter)
+				numPairs += GetNumBits(bigrams[letter]);
+
+			const unsigned numLetters = GetNumBits(boardLetters);
+			if (numPairs*100 > numLetters*numLetters*BIGRAM_MASK_MAX_DENSITY)
+			{
+				debug_print("Bigram mask switched off: %u of %u letter pairs adjacent (%ux%u board).\n", numPairs, numLetters*numLetters, width, height);
+
+				memset(bigrams, 0xff, sizeof(bigrams));
+				return;
+			}
+		}
+	}
+}
+
+#endif
+
+#if defined(RELAXED_PREFILTER)
+
+// Tile sets up to this size are kept as a list rather than a bitset (see Query::Prefilter()), if that's any cheaper.
+constexpr unsigned kPrefilterListSize = 64;
+
+// Bitsets have this many words of zeroes either side, so a row up or down never needs a bounds check.
+BOGGLE_INLINE_FORCE static size_t GetPrefilterGuardWords(unsigned pitch)
+{
+	return (pitch >> 6) + 2;
+}
+
+void Query::FindLetterBoards()
+{
+	constexpr unsigned kLetterRange = kAlphaRange+USE_EXTRA_INDEX;
+
+	const size_t gridSize = GetPaddedGridSize(m_width, m_height);
+	m_boardWords = (gridSize+63)/64;
+	m_boardGuard = GetPrefilterGuardWords(m_width+2);
+	m_boardPitch = m_boardWords + 2*m_boardGuard;
+
+	// A tile on a list costs about as much as a few words of bitset.
+	m_listSize = unsigned(std::min<size_t>(kPrefilterListSize, 2*m_boardWords));
+	m_letterBoards.assign(kLetterRange*m_boardPitch, 0);
+
+	for (size_t index = 0; index < gridSize; ++index)
+	{
+		const unsigned letter = uint8_t(m_sanitized[index]);
+		if (letter < kLetterRange) // Not the border
+			GetLetterBoard(letter)[index >> 6] |= 1ull << (index & 63);
+	}
+}
+
+// Per trie level: 2 bitsets (tiles next to the current set, and those the child is on), 2 lists (the same, sparse).
+BOGGLE_INLINE_FORCE static size_t GetPrefilterLevelWords(size_t boardPitch)
+{
+	return 2*boardPitch + 8*kPrefilterListSize;
+}
+
+// Plus a bitset for whatever's in between and one to mark tiles with.
+static size_t GetPrefilterScratchSize(size_t boardPitch)
+{
+	return (2*boardPitch + (MAX_WORD_LEN+1)*GetPrefilterLevelWords(boardPitch))*sizeof(uint64_t);
+}
+
+// Takes out the children of 'node' that can't lead to a word, given the tiles it's prefix can end on if tiles could be
+// reused ('tiles', a bit per padded tile), which is a superset of the real thing. Tiles next to a set of them are a few
+// shifts and OR's, 64 at a time: the border (never a letter) stops rows from bleeding into each other. Once sets get
+// small enough (deeper down, mostly) they're lists instead, as looking around each tile is cheaper by then.
+// Returns false if no word can be found from 'node' at all.
+bool Query::Prefilter(ThreadContext& context, DictionaryNode* node, const uint64_t* tiles, PrefilterScratch scratch)
+{
+	const unsigned children = node->HasChildren();
+	if (0 == children)
+		return 0 != node->HasWord();
+
+	const size_t numWords = m_boardWords;
+	const unsigned pitch = m_width+2;
+	const unsigned rowWords = pitch >> 6, rowBits = pitch & 63;
+
+	uint64_t* row      = scratch.row;
+	uint64_t* adjacent = scratch.level + m_boardGuard;
+	uint64_t* next     = adjacent + m_boardPitch;
+	uint32_t* list     = reinterpret_cast<uint32_t*>(scratch.level + 2*m_boardPitch);
+
+	// Tiles plus their left and right neighbours, then the rows above and below those.
+	for (size_t iWord = 0; iWord < numWords; ++iWord)
+		row[iWord] = tiles[iWord] | (tiles[iWord] << 1 | tiles[iWord-1] >> 63) | (tiles[iWord] >> 1 | tiles[iWord+1] << 63);
+
+	for (size_t iWord = 0; iWord < numWords; ++iWord)
+	{
+		const uint64_t* above = row + iWord + rowWords;
+		const uint64_t* below = row + iWord - rowWords;
+
+		uint64_t bits = (tiles[iWord] << 1 | tiles[iWord-1] >> 63) | (tiles[iWord] >> 1 | tiles[iWord+1] << 63);
+		if (0 == rowBits)
+			bits |= above[0] | below[0];
+		else
+			bits |= (above[0] >> rowBits | above[1] << (64-rowBits)) | (below[0] << rowBits | below[-1] >> (64-rowBits));
+
+		adjacent[iWord] = bits;
+	}
+
+	PrefilterScratch deeper = scratch;
+	deeper.level += GetPrefilterLevelWords(m_boardPitch);
+
+	unsigned alive = 0;
+	for (unsigned indexBits = children; 0 != indexBits; indexBits &= indexBits-1)
+	{
+		const unsigned letter = CountTrailingZeros64(indexBits);
+		const uint64_t* letterTiles = GetLetterBoard(letter);
+
+		size_t numTiles = 0;
+		for (size_t iWord = 0; iWord < numWords; ++iWord)
+		{
+			next[iWord] = adjacent[iWord] & letterTiles[iWord];
+			numTiles += CountBits64(next[iWord]);
+		}
+
+		if (0 == numTiles)
+			continue;
+
+		bool found;
+		if (numTiles <= m_listSize)
+		{
+			unsigned iTile = 0;
+			for (size_t iWord = 0; iWord < numWords; ++iWord)
+			{
+				for (uint64_t bits = next[iWord]; 0 != bits; bits &= bits-1)
+					list[iTile++] = uint32_t(iWord*64 + CountTrailingZeros64(bits));
+			}
+
+			found = Prefilter(context, node->GetChild(letter), list, iTile, deeper);
+		}
+		else
+			found = Prefilter(context, node->GetChild(letter), next, deeper);
+
+		if (found)
+			alive |= 1 << letter;
+	}
+
+	return OnPrefiltered(context, node, children, alive);
+}
+
+// Same, given a list of 'numTiles' tiles (at most kPrefilterListSize).
+bool Query::Prefilter(ThreadContext& context, DictionaryNode* node, const uint32_t* tiles, unsigned numTiles, PrefilterScratch scratch)
+{
+	const unsigned children = node->HasChildren();
+	if (0 == children)
+		return 0 != node->HasWord();
+
+	const int* neighbours = context.neighbours;
+
+	uint64_t* marked = scratch.marked;
+	uint32_t* adjacent = reinterpret_cast<uint32_t*>(scratch.level + 2*m_boardPitch);
+	uint32_t* next = adjacent + 8*kPrefilterListSize;
+
+	// Each tile next to 'tiles' that may follow, once.
+	unsigned numAdjacent = 0;
+	unsigned letterTiles[kAlphaRange+USE_EXTRA_INDEX+1] = { 0 };
+	for (unsigned iTile = 0; iTile < numTiles; ++iTile)
+	{
+		for (unsigned iNeighbour = 0; iNeighbour < 8; ++iNeighbour)
+		{
+			const uint32_t tile = uint32_t(int(tiles[iTile]) + neighbours[iNeighbour]);
+			const unsigned letter = uint8_t(m_sanitized[tile]);
+			if (letter >= kAlphaRange+USE_EXTRA_INDEX || !(children & (1 << letter)))
+				continue;
+
+			const uint64_t bit = 1ull << (tile & 63);
+			if (0 == (marked[tile >> 6] & bit))
+			{
+				marked[tile >> 6] |= bit;
+				adjacent[numAdjacent++] = tile;
+				++letterTiles[letter+1];
+			}
+		}
+	}
+
+	// Then sorted by letter: those holding letter L are [letterTiles[L], letterTiles[L+1]) of 'next'.
+	for (unsigned letter = 0; letter < kAlphaRange+USE_EXTRA_INDEX; ++letter)
+		letterTiles[letter+1] += letterTiles[letter];
+
+	unsigned slots[kAlphaRange+USE_EXTRA_INDEX];
+	memcpy(slots, letterTiles, sizeof(slots));
+	for (unsigned iTile = 0; iTile < numAdjacent; ++iTile)
+	{
+		const uint32_t tile = adjacent[iTile];
+		marked[tile >> 6] = 0;
+		next[slots[uint8_t(m_sanitized[tile])]++] = tile;
+	}
+
+	PrefilterScratch deeper = scratch;
+	deeper.level += GetPrefilterLevelWords(m_boardPitch);
+
+	unsigned alive = 0;
+	for (unsigned indexBits = children; 0 != indexBits; indexBits &= indexBits-1)
+	{
+		const unsigned letter = CountTrailingZeros64(indexBits);
+		const uint32_t* letterNext = next + letterTiles[letter];
+		const unsigned numNext = letterTiles[letter+1] - letterTiles[letter];
+
+		if (0 == numNext)
+			continue;
+
+		bool found;
+		if (numNext <= m_listSize)
+			found = Prefilter(context, node->GetChild(letter), letterNext, numNext, deeper);
+		else
+		{
+			// Grew too large: back to a bitset.
+			uint64_t* bits = scratch.level + m_boardGuard + m_boardPitch;
+			memset(bits, 0, m_boardWords*sizeof(uint64_t));
+			for (unsigned iTile = 0; iTile < numNext; ++iTile)
+				bits[letterNext[iTile] >> 6] |= 1ull << (letterNext[iTile] & 63);
+
+			found = Prefilter(context, node->GetChild(letter), bits, deeper);
+		}
+
+		if (found)
+			alive |= 1 << letter;
+	}
+
+	return OnPrefiltered(context, node, children, alive);
+}
+
+// Takes out what Prefilter() found to be dead (if anything) and returns if there's anything left to find from 'node'.
+BOGGLE_INLINE_FORCE bool Query::OnPrefiltered(ThreadContext& context, DictionaryNode* node, unsigned children, unsigned alive)
+{
+	if (alive != children)
+	{
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		NodeState& state = context.GetState(node);
+		state.epoch = context.epoch;
+		state.indexBits = alive;
+#else
+		for (unsigned dead = children & ~alive; 0 != dead; dead &= dead-1)
+			node->RemoveChild(CountTrailingZeros64(dead));
+
+		context.OnNodeChanged(node);
+#endif
+	}
+
+	return 0 != alive || 0 != node->HasWord();
+}
+
+// The root has no tile to go from: it's children can be on any tile holding their letter.
+void Query::Prefilter(ThreadContext& context, DictionaryNode* root, uint64_t* scratch)
+{
+	// Guards (and marks) have to be zero; the rest is written before it's read.
+	memset(scratch, 0, GetPrefilterScratchSize(m_boardPitch));
+
+	PrefilterScratch levels;
+	levels.row = scratch + m_boardGuard;
+	levels.marked = scratch + m_boardPitch;
+	levels.level = scratch + 2*m_boardPitch;
+
+	for (unsigned indexBits = root->HasChildren(); 0 != indexBits; indexBits &= indexBits-1)
+	{
+		const unsigned letter = CountTrailingZeros64(indexBits);
+		if (false == Prefilter(context, root->GetChild(letter), GetLetterBoard(letter), levels))
+		{
+#if !defined(NON_DESTRUCTIVE_TRAVERSAL)
+			// Traverse() doesn't look at the state of the root in the other case.
+			root->RemoveChild(letter);
+			context.OnNodeChanged(root);
+#endif
+		}
+	}
+}
+
+#endif
+
+// Sets up the thread's heap, dictionary (copy) and grid; returns the root.
+DictionaryNode* Query::PrepareThread(unsigned iThread, std::vector<unsigned>& wordsFound, char*& visited)
+{
+	// Prepare this thread's heap.
+	const auto gridSize = GetPaddedGridSize(m_width, m_height);
+	const size_t overhead = tlsf_alloc_overhead();
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+	size_t threadHeapSize = 
+		gridSize*sizeof(char) + overhead + // Visited grid
+		1024*1024; // Overhead
+#else
+	size_t threadHeapSize = 
+		gridSize*sizeof(char) + overhead +                              // Visited grid
+		s_threadInfo[iThread].nodes*sizeof(DictionaryNode) + overhead + // Dictionary nodes
+		1024*1024; // Overhead
+#endif
+
+#if defined(RELAXED_PREFILTER)
+	threadHeapSize += GetPrefilterScratchSize(m_boardPitch) + overhead;
+#endif
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+	// Use the shared pool, which is never written to in this mode.
+	auto* root = const_cast<DictionaryNode*>(s_threadPools[iThread]);
+	NextEpoch(iThread);
+#else
+	// Create copy of dictionary tree for this thread
+	const auto threadCopy = DictionaryNode::ThreadCopy(iThread);
+	auto* root = threadCopy.Get();
+#endif
+
+	// Copy grid
+	visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(gridSize*sizeof(char), kAlignTo));
+	memcpy(visited, m_sanitized, gridSize);
+	// ClosePrefetch(visited);
+
+	wordsFound.clear();
+	wordsFound.reserve(s_threadInfo[iThread].load);
+
+	return root;
+}
+
+void Query::FinishThread(unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	std::sort(wordsFound.begin(), wordsFound.end());
+
+#if defined(NED_FLANDERS)
+	for (unsigned wordIdx : wordsFound)
+	{
+		const size_t length = strlen(s_wordTable[wordIdx].word);
+//		const size_t length = s_wordTable[wordIdx].word.length(); 
+		m_reqStrBufSize += length + 1; // Plus one for zero terminator
+	}
+#endif
+
+#if defined(DEBUG_STATS)
+	if (s_threadInfo[iThread].load > 0)
+	{
+		const float hitPct = float(wordsFound.size())/s_threadInfo[iThread].load;
+		debug_print("Thread %u has max. traversal depth %u (max. %u), hit rate %.2f\n", iThread, m_maxDepth, s_longestWord, hitPct); 
+	}
+#endif
+}
+
+void Query::ExecuteThread(unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+#if defined(LOUDS_TRIE)
+	// The pools are gone, so before LETTER_HISTOGRAM looks at them.
+	ExecuteLoudsThread(iThread, wordsFound);
+	return;
+#endif
+
+#if defined(LETTER_HISTOGRAM)
+	// Not a single word in this shard starts with a letter on the board? Then don't even bother copying it.
+	if (0 == (s_threadPools[iThread]->HasChildren() & m_letters->boardLetters))
+	{
+		wordsFound.clear();
+		return;
+	}
+#endif
+
+#if defined(PREFIX_HASH_ENGINE)
+	if (true == s_usePrefixHash)
+	{
+		ExecutePrefixHashThread(iThread, wordsFound);
+		return;
+	}
+#endif
+
+#if defined(DOUBLE_ARRAY_TRIE)
+	// Doesn't touch the pool at all.
+	ExecuteArrayThread(iThread, wordsFound);
+	return;
+#endif
+
+#if defined(DAWG_DICTIONARY)
+	ExecuteDawgThread(iThread, wordsFound);
+	return;
+#endif
+
+	char* visited;
+	auto* root = PrepareThread(iThread, wordsFound, visited);
+
+	ThreadContext context(wordsFound, m_width+2);
+
+#if defined(PREFIX_TABLE)
+	context.prefixTable = &s_prefixTable[iThread*kAlphaRange*kAlphaRange];
+#endif
+
+#if defined(NODE_SIDE_TABLES)
+	context.SetNodes(root, iThread);
+#endif
+
+#if defined(LETTER_HISTOGRAM)
+	context.SetLetterCounts(m_letters->letterCounts);
+#endif
+
+#if defined(BIGRAM_MASK)
+	context.bigrams = m_letters->bigrams;
+#endif
+
+#if defined(NEIGHBOUR_MASKS)
+	context.SetNeighbourMasks(visited, m_neighbourMasks);
+#endif
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+	context.pool   = root;
+	context.states = s_threadStates[iThread];
+	context.epoch  = s_threadEpochs[iThread];
+#endif
+
+#if defined(DEBUG_STATS)
+	debug_print("Thread %u has a load of %zu words and %zu nodes (%zu KB).\n", iThread, s_threadInfo[iThread].load, s_threadInfo[iThread].nodes,
+		s_threadInfo[iThread].nodes*sizeof(DictionaryNode)/1024);
+	m_maxDepth = 0;
+#endif
+
+#if defined(RELAXED_PREFILTER)
+	if (0 != m_boardPitch)
+	{
+		auto* scratch = static_cast<uint64_t*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(GetPrefilterScratchSize(m_boardPitch), kAlignTo));
+		Prefilter(context, root, scratch);
+	}
+#endif
+
+	Traverse(context, root, visited);
+
+	FinishThread(iThread, wordsFound);
+}
+
+// Runs all of the batch against this thread's shard: one heap reset and (at most) one dictionary copy for all of it.
+/* static */ void Query::ExecuteBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+#if defined(LOUDS_TRIE)
+	ExecuteLoudsBatchThread(batch, iThread, wordsFound);
+	return;
+#endif
+
+#if defined(PREFIX_HASH_ENGINE)
+	if (true == s_usePrefixHash)
+	{
+		ExecutePrefixHashBatchThread(batch, iThread, wordsFound);
+		return;
+	}
+#endif
+
+#if defined(DOUBLE_ARRAY_TRIE)
+	ExecuteArrayBatchThread(batch, iThread, wordsFound);
+	return;
+#endif
+
+#if defined(DAWG_DICTIONARY)
+	ExecuteDawgBatchThread(batch, iThread, wordsFound);
+	return;
+#endif
+
+	const size_t overhead = tlsf_alloc_overhead();
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+	const size_t threadHeapSize = 
+		batch.maxGridSize*sizeof(char) + overhead + // Visited grid
+		1024*1024; // Overhead
+#else
+	const size_t numNodes = s_threadInfo[iThread].nodes;
+
+	const size_t threadHeapSize = 
+		batch.maxGridSize*sizeof(char) + overhead +        // Visited grid
+		numNodes*sizeof(DictionaryNode) + overhead +       // Dictionary nodes
+		2*numNodes*sizeof(DictionaryNode*) + overhead +    // Changed nodes
+		1024*1024; // Overhead
+#endif
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+	auto* root = const_cast<DictionaryNode*>(s_threadPools[iThread]);
+#else
+	auto threadCopy = DictionaryNode::ThreadCopy(iThread);
+	auto* root = threadCopy.Get();
+
+	auto** changed = static_cast<DictionaryNode**>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(2*numNodes*sizeof(DictionaryNode*), kAlignTo));
+#endif
+
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(batch.maxGridSize*sizeof(char), kAlignTo));
+
+	wordsFound.clear();
+
+	for (unsigned iBoard = 0; iBoard < batch.count; ++iBoard)
+	{
+		const char* sanitized = batch.sanitized[iBoard];
+		if (nullptr != sanitized)
+		{
+			const unsigned width  = batch.widths[iBoard];
+			const unsigned height = batch.heights[iBoard];
+			memcpy(visited, sanitized, GetPaddedGridSize(width, height));
+
+			ThreadContext context(wordsFound, width+2);
+
+#if defined(PREFIX_TABLE)
+			context.prefixTable = &s_prefixTable[iThread*kAlphaRange*kAlphaRange];
+#endif
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+			// New epoch, clean slate.
+			context.pool   = root;
+			context.states = s_threadStates[iThread];
+			context.epoch  = NextEpoch(iThread);
+#else
+			context.changed = changed;
+#endif
+
+			Query query(batch.results[iBoard], sanitized, width, height, &batch.letters[iBoard]);
+#if defined(DEBUG_STATS)
+			query.m_maxDepth = 0;
+#endif
+
+#if defined(NODE_SIDE_TABLES)
+			context.SetNodes(root, iThread);
+#endif
+
+#if defined(LETTER_HISTOGRAM)
+			context.SetLetterCounts(query.m_letters->letterCounts);
+#endif
+
+#if defined(BIGRAM_MASK)
+			context.bigrams = query.m_letters->bigrams;
+#endif
+
+#if defined(NEIGHBOUR_MASKS)
+			context.SetNeighbourMasks(visited, batch.neighbourMasks[iBoard]);
+#endif
+
+			const size_t begin = wordsFound.size();
+			query.Traverse(context, root, visited);
+			std::sort(wordsFound.begin()+begin, wordsFound.end());
+
+#if !defined(NON_DESTRUCTIVE_TRAVERSAL)
+			// Back to pristine for the next board.
+			threadCopy.Restore(changed, context.numChanged);
+#endif
+		}
+
+		batch.wordsEnd[iThread*batch.count + iBoard] = wordsFound.size();
+	}
+}
+
+#if defined(BOARD_PARTITIONING)
+
+// Picks up squares until there are none left (or all words have been found), traversing all shards from each tile in them.
+void Query::ExecuteSquares(unsigned iWorker, std::vector<unsigned>& wordsFound)
+{
+	const unsigned width  = m_width;
+	const unsigned height = m_height;
+
+	// Words starting in a square can't reach any further than this.
+	constexpr unsigned kSquare = BOARD_PARTITION_SQUARE;
+	constexpr unsigned kHalo = MAX_WORD_LEN;
+	constexpr unsigned kPitch = kSquare + 2*kHalo + 2; // Plus border
+
+	const unsigned pitch = width+2;
+	const char* board = m_sanitized + pitch + 1;
+
+	ResetThreadHeap(iWorker, kPitch*kPitch*sizeof(char) + tlsf_alloc_overhead() + 1024*1024);
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iWorker].AllocateAlignedUnsafe(kPitch*kPitch*sizeof(char), kAlignTo));
+
+	// Shared (read-only) dictionary, but this worker's own idea of what's been found (any shard).
+	ThreadContext context(wordsFound, kPitch);
+	context.epoch    = NextWorkerEpoch(iWorker);
+	context.pool     = s_threadPools[0];
+	context.states   = s_workerStates[iWorker];
+	context.found    = m_found.get();
+	context.numFound = &m_numFound;
+
+#if defined(NODE_SIDE_TABLES)
+	context.SetNodes(s_threadPools[0], 0);
+#endif
+
+#if defined(LETTER_HISTOGRAM)
+	// Whole board, so it's on the safe side for any square.
+	context.SetLetterCounts(m_letters->letterCounts);
+#endif
+
+#if defined(BIGRAM_MASK)
+	context.bigrams = m_letters->bigrams;
+#endif
+
+	// No neighbour masks: they're laid out like the board, not the squares.
+
+	wordsFound.clear();
+
+	const unsigned numSquaresX = (width+kSquare-1)/kSquare;
+	const unsigned numSquares = numSquaresX*((height+kSquare-1)/kSquare);
+
+	unsigned iSquare;
+	while ((iSquare = m_nextSquare.fetch_add(1, std::memory_order_relaxed)) < numSquares)
+	{
+		const unsigned squareX = (iSquare % numSquaresX)*kSquare;
+		const unsigned squareY = (iSquare / numSquaresX)*kSquare;
+		const unsigned squareWidth  = std::min(kSquare, width-squareX);
+		const unsigned squareHeight = std::min(kSquare, height-squareY);
+
+		// Copy it along with the halo, as far as the board goes.
+		const unsigned left = squareX - std::min(squareX, kHalo), top = squareY - std::min(squareY, kHalo);
+		const unsigned right = std::min(width, squareX+squareWidth+kHalo), bottom = std::min(height, squareY+squareHeight+kHalo);
+		const unsigned haloWidth = right-left;
+
+		// Border around whatever part of it is copied.
+		memset(visited, kTileBorder, kPitch*kPitch);
+		for (unsigned iY = top; iY < bottom; ++iY)
+			memcpy(visited + (iY-top+1)*kPitch + 1, board + size_t(iY)*pitch + left, haloWidth);
+
+		for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+		{
+			auto* root = const_cast<DictionaryNode*>(s_threadPools[iThread]);
+
+#if defined(LETTER_HISTOGRAM)
+			if (0 == (root->HasChildren() & m_letters->boardLetters))
+				continue;
+#endif
+
+			for (unsigned iY = squareY-top+1; iY <= squareY-top+squareHeight; ++iY)
+			{
+				const unsigned offsetY = iY*kPitch;
+				for (unsigned iX = squareX-left+1; iX <= squareX-left+squareWidth; ++iX)
+				{
+					if (auto* child = root->GetChildChecked(visited[offsetY+iX]))
+					{
+#if defined(DEBUG_STATS)
+						TraverseBoard(context, &visited[offsetY+iX], child, 1);
+#else
+						TraverseBoard(context, &visited[offsetY+iX], child);
+#endif
+					}
+				}
+			}
+		}
+
+		// Nothing left to find?
+		if (s_wordCount == m_numFound.load(std::memory_order_relaxed))
+			break;
+	}
+
+	FinishThread(iWorker, wordsFound);
+}
+
+#endif // BOARD_PARTITIONING
+
+// Starts from every tile of the board.
+void Query::Traverse(ThreadContext& context, DictionaryNode* root, char* visited)
+{
+	const unsigned width  = m_width;
+	const unsigned height = m_height;
+	const unsigned pitch  = width+2;
+
+#if defined(PREFIX_TABLE)
+	const int* neighbours = context.neighbours;
+#endif
+
+	// Inside the border only.
+	for (unsigned offsetY = pitch; offsetY <= pitch*height; offsetY += pitch) 
+	{
+		// Try to get the next line closer by
+		NearPrefetch(visited + offsetY+pitch);
+
+		for (unsigned iX = 1; iX <= width; ++iX) 
+		{
+#if defined(PREFIX_TABLE)
+			char* tile = &visited[offsetY+iX];
+			const unsigned first = *tile;
+			if (!root->HasChild(first))
+				continue;
+
+			// Does what TraverseBoard() would for the first letter, save for pruning: the first level is left alone.
+			const uint32_t* offsets = context.prefixTable + (first-USE_EXTRA_INDEX)*kAlphaRange - USE_EXTRA_INDEX;
+
+#if defined(LETTER_HISTOGRAM)
+			context.OnVisit(first);
+#endif
+			*tile |= kTileVisitedBit;
+
+			for (unsigned iNeighbour = 0; iNeighbour < 8; ++iNeighbour)
+			{
+				char* next = tile + neighbours[iNeighbour];
+				if (*next & kTileVisitedBit)
+					continue;
+
+				const uint32_t offset = offsets[unsigned(*next)];
+				if (0 == offset)
+					continue;
+
+				auto* node = reinterpret_cast<DictionaryNode*>(reinterpret_cast<char*>(root) + offset);
+
+#if !defined(NON_DESTRUCTIVE_TRAVERSAL)
+				// Pruned all the way (TraverseBoard() knows in the other case)?
+				if (!node->HasChildren() && !node->HasWord())
+					continue;
+#endif
+
+#if defined(LETTER_HISTOGRAM)
+				if (false == context.CanFinish(node))
+					continue;
+#endif
+
+#if defined(DEBUG_STATS)
+				TraverseBoard(context, next, node, 2);
+#else
+				TraverseBoard(context, next, node);
+#endif
+			}
+
+			*tile ^= kTileVisitedBit;
+#if defined(LETTER_HISTOGRAM)
+			context.OnLeave(first);
+#endif
+#else
+			if (auto* child = root->GetChildChecked(visited[offsetY+iX]))
+			{
+#if defined(DEBUG_STATS)
+				TraverseBoard(context, &visited[offsetY+iX], child, 1);
+#else
+				TraverseBoard(context, &visited[offsetY+iX], child);
+#endif
+			}
+#endif
+		}
+	}
+}
+
+#if defined(DOUBLE_ARRAY_TRIE)
+
+void Query::ExecuteArrayThread(unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	const DoubleArray& array = s_doubleArrays[iThread];
+
+	const auto gridSize = GetPaddedGridSize(m_width, m_height);
+	const size_t bitsSize = ThreadContext::GetStateBitsSize(array);
+	const size_t overhead = tlsf_alloc_overhead();
+
+	const size_t threadHeapSize = 
+		gridSize*sizeof(char) + overhead + // Visited grid
+		bitsSize + overhead +              // State bits
+		1024*1024; // Overhead
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(gridSize*sizeof(char), kAlignTo));
+	memcpy(visited, m_sanitized, gridSize);
+
+	auto* bits = static_cast<uint64_t*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(bitsSize, kAlignTo));
+	memset(bits, 0, bitsSize);
+
+	wordsFound.clear();
+	wordsFound.reserve(s_threadInfo[iThread].load);
+
+	ThreadContext context(wordsFound, m_width+2);
+	context.SetArray(array, bits);
+
+#if defined(DEBUG_STATS)
+	m_maxDepth = 0;
+#endif
+
+	TraverseArray(context, visited);
+
+	FinishThread(iThread, wordsFound);
+}
+
+/* static */ void Query::ExecuteArrayBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	const DoubleArray& array = s_doubleArrays[iThread];
+
+	const size_t bitsSize = ThreadContext::GetStateBitsSize(array);
+	const size_t overhead = tlsf_alloc_overhead();
+
+	const size_t threadHeapSize = 
+		batch.maxGridSize*sizeof(char) + overhead + // Visited grid
+		bitsSize + overhead +                       // State bits
+		1024*1024; // Overhead
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(batch.maxGridSize*sizeof(char), kAlignTo));
+	auto* bits = static_cast<uint64_t*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(bitsSize, kAlignTo));
+
+	wordsFound.clear();
+
+	for (unsigned iBoard = 0; iBoard < batch.count; ++iBoard)
+	{
+		const char* sanitized = batch.sanitized[iBoard];
+		if (nullptr != sanitized)
+		{
+			const unsigned width  = batch.widths[iBoard];
+			const unsigned height = batch.heights[iBoard];
+			memcpy(visited, sanitized, GetPaddedGridSize(width, height));
+			memset(bits, 0, bitsSize);
+
+			ThreadContext context(wordsFound, width+2);
+			context.SetArray(array, bits);
+
+			Query query(batch.results[iBoard], sanitized, width, height, &batch.letters[iBoard]);
+#if defined(DEBUG_STATS)
+			query.m_maxDepth = 0;
+#endif
+
+			const size_t begin = wordsFound.size();
+			query.TraverseArray(context, visited);
+			std::sort(wordsFound.begin()+begin, wordsFound.end());
+		}
+
+		batch.wordsEnd[iThread*batch.count + iBoard] = wordsFound.size();
+	}
+}
+
+// Like Traverse(), from the root state.
+void Query::TraverseArray(ThreadContext& context, char* visited)
+{
+	const unsigned width  = m_width;
+	const unsigned height = m_height;
+	const unsigned pitch  = width+2;
+
+	const DoubleArraySlot* slots = context.slots;
+	const uint32_t base = uint32_t(slots[0].base);
+
+	// Inside the border only.
+	for (unsigned offsetY = pitch; offsetY <= pitch*height; offsetY += pitch) 
+	{
+		NearPrefetch(visited + offsetY+pitch);
+
+		for (unsigned iX = 1; iX <= width; ++iX) 
+		{
+			const uint32_t state = base + uint8_t(visited[offsetY+iX]);
+			if (0 == slots[state].check && false == context.IsExhausted(state))
+				TraverseArray(context, &visited[offsetY+iX], state);
+		}
+	}
+}
+
+void Query::TraverseArray(ThreadContext& context, char* visited, uint32_t state)
+{
+	const int32_t wordIdx = context.words[state];
+	if (wordIdx >= 0 && false == context.IsFound(state))
+	{
+		context.OnFound(state);
+		context.wordsFound.push_back(unsigned(wordIdx));
+	}
+
+	*visited |= kTileVisitedBit;
+
+	// Visited tiles (and the border) are well out of the letter range: check them first, as slots only go as far as that.
+	const DoubleArraySlot* slots = context.slots;
+	const uint32_t base = uint32_t(slots[state].base);
+	for (unsigned iNeighbour = 0; iNeighbour < 8; ++iNeighbour)
+	{
+		char* next = visited + context.neighbours[iNeighbour];
+		const unsigned letter = uint8_t(*next);
+		if (letter & kTileVisitedBit)
+			continue;
+
+		const uint32_t target = base + letter;
+		if (int32_t(state) == slots[target].check && false == context.IsExhausted(target))
+			TraverseArray(context, next, target);
+	}
+
+	*visited ^= kTileVisitedBit;
+
+	// All of what follows done as well? Then there's no reason to come back.
+	for (unsigned letters = context.children[state]; 0 != letters; letters &= letters-1)
+	{
+		if (false == context.IsExhausted(base + CountTrailingZeros64(letters)))
+			return;
+	}
+
+	context.OnExhausted(state);
+}
+
+#endif
+
+#if defined(DAWG_DICTIONARY)
+
+void Query::ExecuteDawgThread(unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	const Dawg& dawg = s_dawgs[iThread];
+
+	const auto gridSize = GetPaddedGridSize(m_width, m_height);
+	const size_t foundSize = ThreadContext::GetFoundBitsSize(dawg);
+	const size_t overhead = tlsf_alloc_overhead();
+
+	const size_t threadHeapSize = 
+		gridSize*sizeof(char) + overhead + // Visited grid
+		foundSize + overhead +             // Found bits
+		1024*1024; // Overhead
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(gridSize*sizeof(char), kAlignTo));
+	memcpy(visited, m_sanitized, gridSize);
+
+	auto* found = static_cast<uint64_t*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(foundSize, kAlignTo));
+	memset(found, 0, foundSize);
+
+	wordsFound.clear();
+	wordsFound.reserve(s_threadInfo[iThread].load);
+
+	ThreadContext context(wordsFound, m_width+2);
+	context.SetDawg(dawg, found);
+
+#if defined(DEBUG_STATS)
+	m_maxDepth = 0;
+#endif
+
+	TraverseDawg(context, visited);
+
+	FinishThread(iThread, wordsFound);
+}
+
+/* static */ void Query::ExecuteDawgBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	const Dawg& dawg = s_dawgs[iThread];
+
+	const size_t foundSize = ThreadContext::GetFoundBitsSize(dawg);
+	const size_t overhead = tlsf_alloc_overhead();
+
+	const size_t threadHeapSize = 
+		batch.maxGridSize*sizeof(char) + overhead + // Visited grid
+		foundSize + overhead +                      // Found bits
+		1024*1024; // Overhead
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(batch.maxGridSize*sizeof(char), kAlignTo));
+	auto* found = static_cast<uint64_t*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(foundSize, kAlignTo));
+
+	wordsFound.clear();
+
+	for (unsigned iBoard = 0; iBoard < batch.count; ++iBoard)
+	{
+		const char* sanitized = batch.sanitized[iBoard];
+		if (nullptr != sanitized)
+		{
+			const unsigned width  = batch.widths[iBoard];
+			const unsigned height = batch.heights[iBoard];
+			memcpy(visited, sanitized, GetPaddedGridSize(width, height));
+			memset(found, 0, foundSize);
+
+			ThreadContext context(wordsFound, width+2);
+			context.SetDawg(dawg, found);
+
+			Query query(batch.results[iBoard], sanitized, width, height, &batch.letters[iBoard]);
+#if defined(DEBUG_STATS)
+			query.m_maxDepth = 0;
+#endif
+
+			const size_t begin = wordsFound.size();
+			query.TraverseDawg(context, visited);
+			std::sort(wordsFound.begin()+begin, wordsFound.end());
+		}
+
+		batch.wordsEnd[iThread*batch.count + iBoard] = wordsFound.size();
+	}
+}
+
+// Like Traverse(), from the root (rank 0).
+void Query::TraverseDawg(ThreadContext& context, char* visited)
+{
+	const unsigned width  = m_width;
+	const unsigned height = m_height;
+	const unsigned pitch  = width+2;
+
+	const DawgNode& root = context.dawgNodes[0];
+
+	// Inside the border only.
+	for (unsigned offsetY = pitch; offsetY <= pitch*height; offsetY += pitch) 
+	{
+		NearPrefetch(visited + offsetY+pitch);
+
+		for (unsigned iX = 1; iX <= width; ++iX) 
+		{
+			const unsigned letter = visited[offsetY+iX];
+			if (root.indexBits & (1 << letter))
+			{
+				const DawgEdge& edge = context.dawgEdges[root.firstEdge + CountBits(root.indexBits & ((1 << letter)-1))];
+				TraverseDawg(context, &visited[offsetY+iX], edge.node, edge.skip);
+			}
+		}
+	}
+}
+
+void Query::TraverseDawg(ThreadContext& context, char* visited, uint32_t node, uint32_t rank)
+{
+	const DawgNode& current = context.dawgNodes[node];
+
+	// Found all there is to find from here (on this path) already? Can't prune a shared node, but this is as good.
+	if (current.numWords <= 64 && context.IsRangeFound(rank, current.numWords))
+		return;
+
+	if ((current.indexBits & kDawgWordBit) && false == context.IsFound(rank))
+	{
+		context.OnFound(rank);
+		context.wordsFound.push_back(context.dawgWords[rank]);
+	}
+
+	const uint32_t indexBits = current.indexBits & ~kDawgWordBit;
+	if (0 == indexBits)
+		return;
+
+	*visited |= kTileVisitedBit;
+
+	for (unsigned iNeighbour = 0; iNeighbour < 8; ++iNeighbour)
+	{
+		char* next = visited + context.neighbours[iNeighbour];
+		const unsigned letter = uint8_t(*next);
+		if ((letter & kTileVisitedBit) || !(indexBits & (1 << letter)))
+			continue;
+
+		const DawgEdge& edge = context.dawgEdges[current.firstEdge + CountBits(indexBits & ((1 << letter)-1))];
+		TraverseDawg(context, next, edge.node, rank + edge.skip);
+	}
+
+	*visited ^= kTileVisitedBit;
+}
+
+#endif
+
+#if defined(PREFIX_HASH_ENGINE)
+
+void Query::ExecutePrefixHashThread(unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	const PrefixHash& hash = s_prefixHashes[iThread];
+
+	const auto gridSize = GetPaddedGridSize(m_width, m_height);
+	const size_t statesSize = ThreadContext::GetPrefixStatesSize(hash);
+	const size_t overhead = tlsf_alloc_overhead();
+
+	const size_t threadHeapSize = 
+		gridSize*sizeof(char) + overhead + // Visited grid
+		statesSize + overhead +            // Prefix states
+		1024*1024; // Overhead
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(gridSize*sizeof(char), kAlignTo));
+	memcpy(visited, m_sanitized, gridSize);
+
+	auto* states = static_cast<uint8_t*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(statesSize, kAlignTo));
+	memset(states, 0, statesSize);
+
+	wordsFound.clear();
+	wordsFound.reserve(s_threadInfo[iThread].load);
+
+	ThreadContext context(wordsFound, m_width+2);
+	context.SetPrefixHash(hash, states);
+
+#if defined(DEBUG_STATS)
+	m_maxDepth = 0;
+#endif
+
+	TraversePrefixHash(context, visited);
+
+	FinishThread(iThread, wordsFound);
+}
+
+/* static */ void Query::ExecutePrefixHashBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	const PrefixHash& hash = s_prefixHashes[iThread];
+
+	const size_t statesSize = ThreadContext::GetPrefixStatesSize(hash);
+	const size_t overhead = tlsf_alloc_overhead();
+
+	const size_t threadHeapSize = 
+		batch.maxGridSize*sizeof(char) + overhead + // Visited grid
+		statesSize + overhead +                     // Prefix states
+		1024*1024; // Overhead
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(batch.maxGridSize*sizeof(char), kAlignTo));
+	auto* states = static_cast<uint8_t*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(statesSize, kAlignTo));
+
+	wordsFound.clear();
+
+	for (unsigned iBoard = 0; iBoard < batch.count; ++iBoard)
+	{
+		const char* sanitized = batch.sanitized[iBoard];
+		if (nullptr != sanitized)
+		{
+			const unsigned width  = batch.widths[iBoard];
+			const unsigned height = batch.heights[iBoard];
+			memcpy(visited, sanitized, GetPaddedGridSize(width, height));
+			memset(states, 0, statesSize);
+
+			ThreadContext context(wordsFound, width+2);
+			context.SetPrefixHash(hash, states);
+
+			Query query(batch.results[iBoard], sanitized, width, height, &batch.letters[iBoard]);
+#if defined(DEBUG_STATS)
+			query.m_maxDepth = 0;
+#endif
+
+			const size_t begin = wordsFound.size();
+			query.TraversePrefixHash(context, visited);
+			std::sort(wordsFound.begin()+begin, wordsFound.end());
+		}
+
+		batch.wordsEnd[iThread*batch.count + iBoard] = wordsFound.size();
+	}
+}
+
+// Like Traverse(), from the root.
+void Query::TraversePrefixHash(ThreadContext& context, char* visited)
+{
+	const unsigned width  = m_width;
+	const unsigned height = m_height;
+	const unsigned pitch  = width+2;
+
+	const PrefixHash& hash = *context.prefixHash;
+
+	// Once per query instead of once per tile.
+	uint32_t slots[kAlphaRange+USE_EXTRA_INDEX];
+	for (unsigned letter = 0; letter < kAlphaRange+USE_EXTRA_INDEX; ++letter)
+	{
+		const uint32_t key = PrefixHash::GetKey(hash.numSlots, letter);
+		slots[letter] = hash.Find(key, hash.GetBucket(key));
+	}
+
+	// Inside the border only.
+	for (unsigned offsetY = pitch; offsetY <= pitch*height; offsetY += pitch) 
+	{
+		NearPrefetch(visited + offsetY+pitch);
+
+		for (unsigned iX = 1; iX <= width; ++iX) 
+		{
+			const uint32_t slot = slots[uint8_t(visited[offsetY+iX])];
+			if (kNoPrefix != slot && 0 == (context.prefixStates[slot] & ThreadContext::kPrefixDead))
+				TraversePrefixHash(context, &visited[offsetY+iX], slot);
+		}
+	}
+}
+
+void Query::TraversePrefixHash(ThreadContext& context, char* visited, uint32_t slot)
+{
+	const PrefixHash& hash = *context.prefixHash;
+	const PrefixHashEntry& entry = hash.GetEntry(slot);
+	uint8_t* states = context.prefixStates;
+
+	if ((entry.flags & kPrefixWord) && 0 == (states[slot] & ThreadContext::kPrefixFound))
+	{
+		states[slot] |= ThreadContext::kPrefixFound;
+		context.wordsFound.push_back(entry.word);
+	}
+
+	const uint32_t letters = entry.letters;
+	if (0 != letters)
+	{
+		*visited |= kTileVisitedBit;
+
+		// Start fetching all of the buckets before probing any of them.
+		char* next[8];
+		uint32_t keys[8];
+		size_t buckets[8];
+		unsigned numProbes = 0;
+		for (unsigned iNeighbour = 0; iNeighbour < 8; ++iNeighbour)
+		{
+			char* neighbour = visited + context.neighbours[iNeighbour];
+			const unsigned letter = uint8_t(*neighbour);
+			if ((letter & kTileVisitedBit) || !(letters & (1 << letter)))
+				continue;
+
+			next[numProbes] = neighbour;
+			keys[numProbes] = PrefixHash::GetKey(slot, letter);
+			buckets[numProbes] = hash.GetBucket(keys[numProbes]);
+			ClosePrefetch(reinterpret_cast<const char*>(&hash.buckets[buckets[numProbes]]));
+			++numProbes;
+		}
+
+		for (unsigned iProbe = 0; iProbe < numProbes; ++iProbe)
+		{
+			const uint32_t child = hash.Find(keys[iProbe], buckets[iProbe]);
+			if (kNoPrefix != child && 0 == (states[child] & ThreadContext::kPrefixDead))
+				TraversePrefixHash(context, next[iProbe], child);
+		}
+
+		*visited ^= kTileVisitedBit;
+
+		if ((states[slot] & ThreadContext::kPrefixDeadChildren) != CountBits(letters))
+			return;
+	}
+
+	// Word (if any) found and all that follows done: there's no reason to come back, so tell the prefix a letter shorter.
+	states[slot] |= ThreadContext::kPrefixDead;
+	++states[entry.key >> 5];
+}
+
+#endif
+
+#if defined(LOUDS_TRIE)
+
+void Query::ExecuteLoudsThread(unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	const LoudsTrie& louds = s_loudsTries[iThread];
+
+#if defined(LETTER_HISTOGRAM)
+	if (0 == (louds.rootLetters & m_letters->boardLetters))
+	{
+		wordsFound.clear();
+		return;
+	}
+#endif
+
+	const auto gridSize = GetPaddedGridSize(m_width, m_height);
+	const size_t bitsSize = ThreadContext::GetNodeBitsSize(louds);
+	const size_t overhead = tlsf_alloc_overhead();
+
+	const size_t threadHeapSize = 
+		gridSize*sizeof(char) + overhead + // Visited grid
+		bitsSize + overhead +              // Node bits
+		1024*1024; // Overhead
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(gridSize*sizeof(char), kAlignTo));
+	memcpy(visited, m_sanitized, gridSize);
+
+	auto* bits = static_cast<uint64_t*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(bitsSize, kAlignTo));
+	memset(bits, 0, bitsSize);
+
+	wordsFound.clear();
+	wordsFound.reserve(s_threadInfo[iThread].load);
+
+	ThreadContext context(wordsFound, m_width+2);
+	context.SetLouds(louds, bits);
+
+#if defined(DEBUG_STATS)
+	m_maxDepth = 0;
+#endif
+
+	TraverseLouds(context, visited);
+
+	FinishThread(iThread, wordsFound);
+}
+
+/* static */ void Query::ExecuteLoudsBatchThread(Batch& batch, unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	const LoudsTrie& louds = s_loudsTries[iThread];
+
+	const size_t bitsSize = ThreadContext::GetNodeBitsSize(louds);
+	const size_t overhead = tlsf_alloc_overhead();
+
+	const size_t threadHeapSize = 
+		batch.maxGridSize*sizeof(char) + overhead + // Visited grid
+		bitsSize + overhead +                       // Node bits
+		1024*1024; // Overhead
+
+	ResetThreadHeap(iThread, threadHeapSize);
+
+	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(batch.maxGridSize*sizeof(char), kAlignTo));
+	auto* bits = static_cast<uint64_t*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(bitsSize, kAlignTo));
+
+	wordsFound.clear();
+
+	for (unsigned iBoard = 0; iBoard < batch.count; ++iBoard)
+	{
+		const char* sanitized = batch.sanitized[iBoard];
+		if (nullptr != sanitized)
+		{
+			const unsigned width  = batch.widths[iBoard];
+			const unsigned height = batch.heights[iBoard];
+			memcpy(visited, sanitized, GetPaddedGridSize(width, height));
+			memset(bits, 0, bitsSize);
+
+			ThreadContext context(wordsFound, width+2);
+			context.SetLouds(louds, bits);
+
+			Query query(batch.results[iBoard], sanitized, width, height, &batch.letters[iBoard]);
+#if defined(DEBUG_STATS)
+			query.m_maxDepth = 0;
+#endif
+
+			const size_t begin = wordsFound.size();
+			query.TraverseLouds(context, visited);
+			std::sort(wordsFound.begin()+begin, wordsFound.end());
+		}
+
+		batch.wordsEnd[iThread*batch.count + iBoard] = wordsFound.size();
+	}
+}
+
+// Like Traverse(), from the root (node 0).
+void Query::TraverseLouds(ThreadContext& context, char* visited)
+{
+	const unsigned width  = m_width;
+	const unsigned height = m_height;
+	const unsigned pitch  = width+2;
+
+	const LoudsTrie& louds = *context.louds;
+
+	// Once per query instead of once per tile.
+	uint32_t first;
+	const unsigned numChildren = louds.GetChildren(0, first);
+
+	uint32_t children[kAlphaRange+USE_EXTRA_INDEX] = { 0 };
+	for (unsigned iChild = 0; iChild < numChildren; ++iChild)
+		children[louds.labels[first+iChild]] = first+iChild;
+
+	// Inside the border only.
+	for (unsigned offsetY = pitch; offsetY <= pitch*height; offsetY += pitch) 
+	{
+		NearPrefetch(visited + offsetY+pitch);
+
+		for (unsigned iX = 1; iX <= width; ++iX) 
+		{
+			const uint32_t child = children[uint8_t(visited[offsetY+iX])];
+			if (0 != child && false == context.IsDead(child))
+				TraverseLouds(context, &visited[offsetY+iX], child);
+		}
+	}
+}
+
+void Query::TraverseLouds(ThreadContext& context, char* visited, uint32_t node)
+{
+	const LoudsTrie& louds = *context.louds;
+
+	if (louds.HasWord(node) && false == context.IsFound(node))
+	{
+		context.OnFound(node);
+		context.wordsFound.push_back(louds.GetWordIndex(node));
+	}
+
+	uint32_t first;
+	const unsigned numChildren = louds.GetChildren(node, first);
+	if (0 != numChildren)
+	{
+		// Then it's the same as with DictionaryNode.
+		uint32_t indexBits = 0;
+		for (unsigned iChild = 0; iChild < numChildren; ++iChild)
+			indexBits |= 1 << louds.labels[first+iChild];
+
+		*visited |= kTileVisitedBit;
+
+		for (unsigned iNeighbour = 0; iNeighbour < 8; ++iNeighbour)
+		{
+			char* next = visited + context.neighbours[iNeighbour];
+			const unsigned letter = uint8_t(*next);
+			if ((letter & kTileVisitedBit) || !(indexBits & (1 << letter)))
+				continue;
+
+			const uint32_t child = first + CountBits(indexBits & ((1 << letter)-1));
+			if (false == context.IsDead(child))
+				TraverseLouds(context, next, child);
+		}
+
+		*visited ^= kTileVisitedBit;
+
+		if (false == context.IsRangeDead(first, numChildren))
+			return;
+	}
+
+	// Word (if any) found and all that follows done: there's no reason to come back.
+	context.OnDead(node);
+}
+
+#endif
+
+#if defined(WORK_STEALING)
+
+// Calling thread, before the workers are kicked off (which is what makes it safe to push on their behalf).
+void Query::ScheduleTasks()
+{
+	const unsigned gridSize = unsigned(GetPaddedGridSize(m_width, m_height));
+	constexpr unsigned kLetterRange = kAlphaRange+USE_EXTRA_INDEX;
+
+	// Bucket tiles by letter (anything else, such as the border, can't start a word anyway).
+	unsigned counts[kLetterRange] = { 0 };
+	for (unsigned index = 0; index < gridSize; ++index)
+	{
+		const unsigned letter = uint8_t(m_sanitized[index]);
+		if (letter < kLetterRange)
+			++counts[letter];
+	}
+
+	m_letterTiles[0] = 0;
+	for (unsigned letter = 0; letter < kLetterRange; ++letter)
+		m_letterTiles[letter+1] = m_letterTiles[letter] + counts[letter];
+
+	m_tiles = static_cast<unsigned*>(s_globalCustomAlloc.AllocateAlignedUnsafe(gridSize*sizeof(unsigned), kAlignTo));
+
+	unsigned next[kLetterRange];
+	memcpy(next, m_letterTiles, sizeof(next));
+	for (unsigned index = 0; index < gridSize; ++index)
+	{
+		const unsigned letter = uint8_t(m_sanitized[index]);
+		if (letter < kLetterRange)
+			m_tiles[next[letter]++] = index;
+	}
+
+	// Only prefixes that can actually be spelled on this board (letter-wise).
+	m_tasks.clear();
+	for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+	{
+		const size_t begin = m_tasks.size();
+
+		const DictionaryNode* root = s_threadPools[iThread];
+		const uint32_t* prefixNodes = &s_prefixNodes[iThread*kAlphaRange*kAlphaRange];
+
+		for (unsigned first = USE_EXTRA_INDEX; first < kLetterRange; ++first)
+		{
+			if (0 == counts[first] || !root->HasChild(first))
+				continue;
+
+			const DictionaryNode* child = root->GetChild(first);
+			for (unsigned second = USE_EXTRA_INDEX; second < kLetterRange; ++second)
 			{
-				const auto numBits = GetNumBits(s_threadDicts[iThread]->GetIndexBits());
-				if (numBits > maxNumRoots)
+				if (0 != counts[second] && child->HasChild(second))
 				{
-					do
-					{
-						iThread = (iThread-1) % kNumThreads;
-					}
-					while (GetNumBits(s_threadDicts[iThread]->GetIndexBits()) >= maxNumRoots);
+					const uint32_t nodes = prefixNodes[(first-USE_EXTRA_INDEX)*kAlphaRange + second-USE_EXTRA_INDEX];
+					const uint32_t cost = uint32_t(std::min<uint64_t>(uint64_t(nodes)*counts[first], UINT32_MAX));
+					m_tasks.push_back({ cost, uint16_t(iThread), uint8_t(first), uint8_t(second) });
 				}
 			}
 		}
 
-#ifdef NED_FLANDERS		 
-		// Check thread load total.
-		size_t count = 0;
-		for (CONST auto& info : s_threadInfo)
-			count += info.load;
+		// Cheapest on top: the owner pops the most expensive ones first, leaving the small fry for thieves to balance out with.
+		std::sort(m_tasks.begin()+begin, m_tasks.end(), [](const Task& a, const Task& b) { return a.cost < b.cost; });
 
-		if (count != s_wordCount)
-			debug_print("Thread word count (load) %zu != total word count %zu!", count, s_wordCount);
+		auto& deque = s_threadDeques[iThread];
+		deque.Reset(m_tasks.size()-begin);
+
+		for (size_t iTask = begin; iTask < m_tasks.size(); ++iTask)
+			deque.Push(uint32_t(iTask));
+	}
+
+	m_threadRoots.resize(kNumThreads);
+	m_threadGrids.resize(kNumThreads);
+}
+
+void Query::PrepareTasks(unsigned iThread, std::vector<unsigned>& wordsFound)
+{
+	m_threadRoots[iThread] = PrepareThread(iThread, wordsFound, m_threadGrids[iThread]);
+}
+
+void Query::ExecuteTasks(unsigned iWorker, std::vector<unsigned>& wordsFound)
+{
+#if defined(DEBUG_STATS)
+	m_maxDepth = 0;
 #endif
+
+	// Own tasks first, then whatever's left elsewhere.
+	char* visited = m_threadGrids[iWorker];
+
+	uint32_t iTask;
+	while (true == s_threadDeques[iWorker].Pop(iTask) || true == StealTask(iWorker, iTask))
+	{
+		ExecuteTask(m_tasks[iTask], visited, wordsFound);
 	}
 
-	printf("Dictionary loaded. %zu words, longest being %u characters\n", s_wordCount, s_longestWord);
+	FinishThread(iWorker, wordsFound);
 }
 
-void FreeDictionary()
+void Query::ExecuteTask(const Task& task, char* visited, std::vector<unsigned>& wordsFound)
 {
-#ifdef NED_FLANDERS
-	DictionaryLock lock;
+	ThreadContext context(wordsFound, m_width+2);
+
+	// Start right at the prefix, the first 2 levels are shared with other tasks and thus left alone.
+	auto* root = m_threadRoots[task.iThread];
+	auto* node = root->GetChild(task.first)->GetChild(task.second);
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+	context.pool   = root;
+	context.states = s_threadStates[task.iThread];
+	context.epoch  = s_threadEpochs[task.iThread];
+#endif
+
+#if defined(NODE_SIDE_TABLES)
+	context.SetNodes(root, task.iThread);
+#endif
+
+#if defined(LETTER_HISTOGRAM)
+	context.SetLetterCounts(m_letters->letterCounts);
+	if (false == context.CanFinish(node))
+		return;
+#endif
+
+#if defined(BIGRAM_MASK)
+	context.bigrams = m_letters->bigrams;
+#endif
+
+#if defined(NEIGHBOUR_MASKS)
+	context.SetNeighbourMasks(visited, m_neighbourMasks);
 #endif
+
+	for (unsigned iTile = m_letterTiles[task.first]; iTile < m_letterTiles[task.first+1]; ++iTile)
 	{
-		// Delete per-thread dictionary trees.
-		for (auto* root : s_threadDicts)
-			delete root;
+		const unsigned tile = m_tiles[iTile];
 
-		s_threadDicts.clear();
+		visited[tile] |= kTileVisitedBit;
+#if defined(LETTER_HISTOGRAM)
+		context.OnVisit(task.first);
+#endif
 
-		// Reset thread information.
-		s_threadInfo.resize(kNumThreads);
+		for (const int offset : context.neighbours)
+		{
+			char* next = &visited[tile+offset];
+			if (task.second != *next)
+				continue;
 
-		// Reset counters.
-		s_longestWord = 0;
-		s_wordCount = 0;
+#if defined(DEBUG_STATS)
+			TraverseBoard(context, next, node, 2);
+#else
+			TraverseBoard(context, next, node);
+#endif
+
+			// Anything left down here? (visiting it just now took care of it's word)
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+			if (!(context.GetState(node).indexBits & ~kWordFoundBit))
+#else
+			if (!node->HasChildren())
+#endif
+			{
+				visited[tile] ^= kTileVisitedBit;
+				return;
+			}
+		}
+
+		visited[tile] ^= kTileVisitedBit;
+#if defined(LETTER_HISTOGRAM)
+		context.OnLeave(task.first);
+#endif
 	}
 }
 
-// This class contains the actual solver and it's entire context, including a local copy of the dictionary.
-// This means that there will be no problem reloading the dictionary whilst solving, nor will concurrent FindWords()
-// calls cause any fuzz due to globals and such.
+#endif // WORK_STEALING
 
-class Query
+#if !defined(ITERATIVE_TRAVERSAL)
+
+#if defined(DEBUG_STATS)
+BOGGLE_INLINE_FORCE void Query::TraverseCall(ThreadContext& context, char* visited, DictionaryNode* node, uint8_t depth)
+#else
+BOGGLE_INLINE_FORCE void Query::TraverseCall(ThreadContext& context, char* visited, DictionaryNode* node)
+#endif
 {
-public:
-	Query(Results& results, const char* sanitized, unsigned width, unsigned height) :
-		m_results(results)
-,		m_sanitized(sanitized)
-,		m_width(width)
-,		m_height(height) {}
+	if (!(*visited & kTileVisitedBit))
+	{
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		// Parent state is up to date (see TraverseBoard()).
+		NodeState& state = context.GetState(node);
+		const unsigned bit = 1 << *visited;
 
-	~Query() {}
+		if (state.indexBits & bit)
+		{
+			auto* child = node->GetChild(*visited);
 
-	void ExecuteThread(unsigned iThread, std::vector<unsigned>& wordsFound);
+#if defined(LETTER_HISTOGRAM)
+			if (false == context.CanFinish(child))
+				return;
+#endif
 
-	void Execute()
+#if defined(DEBUG_STATS)
+			TraverseBoard(context, visited, child, depth);
+#else
+			TraverseBoard(context, visited, child);
+#endif
+
+			if (!(context.GetState(child).indexBits & ~kWordFoundBit))
+				state.indexBits ^= bit;
+		}
+#else
+		if (auto* child = node->GetChildChecked(*visited))
+		{
+#if defined(LETTER_HISTOGRAM)
+			if (false == context.CanFinish(child))
+				return;
+#endif
+
+#if defined(DEBUG_STATS)
+			TraverseBoard(context, visited, child, depth);
+#else
+			TraverseBoard(context, visited, child);
+#endif
+
+			if (!child->HasChildren())
+			{
+				node->RemoveChild(*visited);
+				context.OnNodeChanged(node);
+			}
+		}
+#endif
+	}
+}
+
+#if defined(DEBUG_STATS)
+void BOGGLE_INLINE Query::TraverseBoard(ThreadContext& context, char* visited, DictionaryNode* node, uint8_t depth)
+#else
+void BOGGLE_INLINE Query::TraverseBoard(ThreadContext& context, char* visited, DictionaryNode* node)
+#endif
+{
+	Assert(nullptr != node);
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+	NodeState& state = context.GetState(node);
+	if (state.epoch != context.epoch)
 	{
-//		debug_printf("Query::Execute(...) for %zu threads!\n", kNumThreads);
+		// First touch this query.
+		state.epoch = context.epoch;
+		state.indexBits = node->HasChildren();
+	}
 
-#if defined(NED_FLANDERS)
-		// Just in case another Execute() call is made on the same context: avoid leaking.
-		FreeWords(m_results);
+	const auto wordIdx = (state.indexBits & kWordFoundBit) ? -1 : node->GetWordIndex();
+#else
+	const auto wordIdx = node->GetWordIndex();
+#endif
 
-		// Bit of a step back from what it was, but as I'm picking words out of the global list now..
-		DictionaryLock dictLock;
-		{
+#if defined(DEBUG_STATS)
+	++depth;
+	Assert(depth <= s_longestWord);
+	m_maxDepth = std::max<unsigned>(m_maxDepth, depth);
 #endif
-			unsigned Count = 0, Score = 0;
 
-			// I'll be copying pointers, plain and simple, but not the safest given the API.
-			m_results.Words = static_cast<char**>(mallocAligned(s_wordCount*sizeof(char*), kAlignTo));
-			char** words_cstr = const_cast<char**>(m_results.Words); 
+#if defined(BIGRAM_MASK) || defined(NEIGHBOUR_MASKS)
+	// Can any of what may follow be found next to this tile at all?
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+	const bool lookAround = context.CanContinue(visited, state.indexBits & ~kWordFoundBit);
+#else
+	const bool lookAround = context.CanContinue(visited, node->HasChildren());
+#endif
+#else
+	constexpr bool lookAround = true;
+#endif
 
-#if defined(NED_FLANDERS) // WIP!
-			m_reqStrBufSize = 0;
+	// Flag tile as visited while we traverse in search of a word (the branch predictor does a good enough job below).
+#if defined(LETTER_HISTOGRAM)
+	context.OnVisit(*visited);
 #endif
+	*visited |= kTileVisitedBit;
 
-			// #pragma omp parallel for reduction(+:Count) reduction(+:Score) schedule(static, 1) num_threads(int(kNumThreads))
-			#pragma omp parallel for schedule(static, 1) num_threads(int(kNumThreads))
-			for (int iThread = 0; iThread < kNumThreads; ++iThread)
-			{
-				std::vector<unsigned> wordsFound;
+#if defined(RADIX_CHAINS)
+	const uint32_t chain = s_chains[context.GetNodeIndex(node)];
+#endif
 
-				ExecuteThread(iThread, wordsFound);
-				
-				// Writes in this loop *should* be atomic, in practice it works out :-)
-				for (const auto wordIdx : wordsFound)
-				{
-					const auto& word = s_words[wordIdx];
-					
-					++Count;
-					Score += unsigned(word.score);
+	if (true == lookAround)
+	{
+#if defined(GRANDCHILD_TABLES)
+		// Dense, so likely to go down more than once from here.
+		if (const uint32_t iTable = s_grandchildIndices[context.GetNodeIndex(node)])
+		{
+			const uint32_t* table = &s_grandchildTables[size_t(iTable-1)*(kAlphaRange+USE_EXTRA_INDEX)*(kAlphaRange+USE_EXTRA_INDEX)];
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+			context.PrefetchGrandchildren(visited, node, state.indexBits & ~kWordFoundBit, table);
+#else
+			context.PrefetchGrandchildren(visited, node, node->HasChildren(), table);
+#endif
+		}
+#endif
 
-#if defined(STREAM_WRITES)
-					_mm_stream_si64((long long*) &(*words_cstr++), reinterpret_cast<long long>(word.word));
-//					_mm_stream_si64((long long*) &(*words_cstr++), reinterpret_cast<long long>(word.word.c_str()));
-	#else
-					*words_cstr++ = const_cast<char*>(word.word);
-//					*words_cstr++ = const_cast<char*>(word.word.c_str());
-	#endif
-				}
-				
-				debug_print("Thread %u completed with %zu words.\n", iThread, wordsFound.size());
-			}
-			
-			m_results.Count = Count;
-			m_results.Score = Score;
+#if defined(RADIX_CHAINS)
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		if (0 != chain && 0 != (state.indexBits & ~kWordFoundBit))
+#else
+		if (0 != chain && 0 != node->HasChildren())
+#endif
+		{
+			// Straight to the end of the chain; the nodes in between would be exhausted along with it.
+			const unsigned length = chain & 7;
+			DictionaryNode* end = node->GetChild((chain >> 3) & 31) + (length-1);
+#if defined(DEBUG_STATS)
+			const bool exhausted = false == FollowChain(context, visited, end, chain >> 3, length, depth);
+#else
+			const bool exhausted = false == FollowChain(context, visited, end, chain >> 3, length);
+#endif
 
-#if defined(NED_FLANDERS)
+			if (true == exhausted)
+			{
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+				state.indexBits &= kWordFoundBit;
+#else
+				node->RemoveChild((chain >> 3) & 31);
+				context.OnNodeChanged(node);
+#endif
+			}
 		}
+		else
 #endif
-	}
-
-private:
-#if defined(DEBUG_STATS)
-	void BOGGLE_INLINE_FORCE TraverseCall(std::vector<unsigned>& wordsFound, char* visited, DictionaryNode* node, unsigned width, unsigned height, unsigned iX, unsigned offsetY, uint8_t depth);
-	void BOGGLE_INLINE TraverseBoard(std::vector<unsigned>& wordsFound, char* visited, DictionaryNode* node, unsigned width, unsigned height, unsigned iX, unsigned offsetY, uint8_t depth);
+#if defined(SIMD_NEIGHBOURS)
+		if (NeighbourKernel::kNone != s_neighbourKernel)
+		{
+			// Only those that may follow (TraverseCall() checks again, as a sibling may just have exhausted a child).
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+			const uint32_t children = state.indexBits & ~kWordFoundBit;
 #else
-	void BOGGLE_INLINE_FORCE TraverseCall(std::vector<unsigned>& wordsFound, char* visited, DictionaryNode* node, unsigned width, unsigned height, unsigned iX, unsigned offsetY);
-	void BOGGLE_INLINE TraverseBoard(std::vector<unsigned>& wordsFound, char* visited, DictionaryNode* node, unsigned width, unsigned height, unsigned iX, unsigned offsetY);
+			const uint32_t children = node->HasChildren();
+#endif
+			unsigned matches = GetMatchingNeighbours(s_neighbourKernel, visited, context.pitch, children);
+#if defined(_DEBUG) || defined(ASSERTIONS)
+			Assert(GetMatchingNeighboursScalar(visited, context.pitch, children) == matches);
 #endif
 
-	Results& m_results;
-	const char* m_sanitized;
-	const unsigned m_width, m_height;
+			while (0 != matches)
+			{
+				const unsigned iBit = CountTrailingZeros64(matches);
+				matches &= matches-1;
 
-#if defined(NED_FLANDERS)
-	size_t m_reqStrBufSize;
+#if defined(DEBUG_STATS)
+				TraverseCall(context, visited + GetNeighbourOffset(iBit, context.pitch), node, depth);
+#else
+				TraverseCall(context, visited + GetNeighbourOffset(iBit, context.pitch), node);
+#endif
+			}
+		}
+		else
 #endif
+		{
+			// Traverse backwards first, hoping that maybe some is still retained in one of the cache levels; the border
+			// takes care of the edges.
+			const int* neighbours = context.neighbours;
 
 #if defined(DEBUG_STATS)
-	unsigned m_maxDepth;
+			TraverseCall(context, visited + neighbours[0], node, depth);
+			TraverseCall(context, visited + neighbours[1], node, depth);
+			TraverseCall(context, visited + neighbours[2], node, depth);
+			TraverseCall(context, visited + neighbours[3], node, depth);
+			TraverseCall(context, visited + neighbours[4], node, depth);
+			TraverseCall(context, visited + neighbours[5], node, depth);
+			TraverseCall(context, visited + neighbours[6], node, depth);
+			TraverseCall(context, visited + neighbours[7], node, depth);
+#else
+			TraverseCall(context, visited + neighbours[0], node);
+			TraverseCall(context, visited + neighbours[1], node);
+			TraverseCall(context, visited + neighbours[2], node);
+			TraverseCall(context, visited + neighbours[3], node);
+			TraverseCall(context, visited + neighbours[4], node);
+			TraverseCall(context, visited + neighbours[5], node);
+			TraverseCall(context, visited + neighbours[6], node);
+			TraverseCall(context, visited + neighbours[7], node);
 #endif
-};
+		}
+	}
+	
+	// Way too close, after an inspection of the assembly.
+//	ClosePrefetch(reinterpret_cast<char*>(node));
 
-void Query::ExecuteThread(unsigned iThread, std::vector<unsigned>& wordsFound)
-{
-	const unsigned width  = m_width;
-	const unsigned height = m_height;
+	// Done!
+	*visited ^= kTileVisitedBit;
+#if defined(LETTER_HISTOGRAM)
+	context.OnLeave(*visited);
+#endif
 
-	// Create copy of dictionary tree for this thread
-	const auto threadCopy = DictionaryNode::ThreadCopy(iThread);
-	auto* root = threadCopy.Get();
+	if (wordIdx & ~0x7fffffff) 
+		return;
 
-	// Copy grid
-	const auto gridSize = width*height;
-	char* visited = static_cast<char*>(s_threadCustomAlloc[iThread].AllocateAlignedUnsafe(gridSize*sizeof(char), kAlignTo));
-	memcpy(visited, m_sanitized, gridSize);
-	// ClosePrefetch(visited);
+//	if (0 == (wordIdx & ~0x7fffffff)) {} 
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+	state.indexBits |= kWordFoundBit;
 
-	wordsFound.reserve(s_threadInfo[iThread].load);
+#if defined(BOARD_PARTITIONING)
+	if (false == context.Claim(wordIdx))
+		return;
+#endif
+#else
+	node->OnWordFound();
+	context.OnNodeChanged(node);
+#endif
+	context.wordsFound.emplace_back(wordIdx);
+}
+
+#if defined(RADIX_CHAINS)
 
+// Looks for the next of 'length' letters around 'visited', which is (for now) marked as such; the last one means 'end'.
+// Returns false once 'end' is exhausted.
 #if defined(DEBUG_STATS)
-	debug_print("Thread %u has a load of %zu words and %zu nodes.\n", iThread, s_threadInfo[iThread].load, s_threadInfo[iThread].nodes);
-	m_maxDepth = 0;
+bool Query::FollowChain(ThreadContext& context, char* visited, DictionaryNode* end, uint32_t letters, unsigned length, uint8_t depth)
+#else
+bool Query::FollowChain(ThreadContext& context, char* visited, DictionaryNode* end, uint32_t letters, unsigned length)
 #endif
+{
+	const char letter = char(letters & 31);
+	const int* neighbours = context.neighbours;
 
-	for (unsigned offsetY = 0; offsetY <= width*(height-1); offsetY += m_width) 
+	for (unsigned iNeighbour = 0; iNeighbour < 8; ++iNeighbour)
 	{
-		// Try to get the next line closer by
-		NearPrefetch(visited + offsetY+width);
+		// Visited tiles (and the border) never match.
+		char* next = visited + neighbours[iNeighbour];
+		if (letter != *next)
+			continue;
 
-		for (unsigned iX = 0; iX < width; ++iX) 
+		if (1 == length)
 		{
-			if (auto* child = root->GetChildChecked(visited[offsetY+iX]))
-			{
+#if defined(LETTER_HISTOGRAM)
+			// Same goes for any other way to get there (for now).
+			if (false == context.CanFinish(end))
+				return true;
+#endif
+
 #if defined(DEBUG_STATS)
-				TraverseBoard(wordsFound, &visited[offsetY+iX], child, width, height, iX, offsetY, 1);
+			TraverseBoard(context, next, end, depth);
 #else
-				TraverseBoard(wordsFound, &visited[offsetY+iX], child, width, height, iX, offsetY);
+			TraverseBoard(context, next, end);
 #endif
-			}
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+			if (!(context.GetState(end).indexBits & ~kWordFoundBit))
+#else
+			if (!end->HasChildren())
+#endif
+				return false;
 		}
-	}
+		else
+		{
+#if defined(LETTER_HISTOGRAM)
+			context.OnVisit(letter);
+#endif
+			*next |= kTileVisitedBit;
 
-	std::sort(wordsFound.begin(), wordsFound.end());
+#if defined(DEBUG_STATS)
+			const bool more = FollowChain(context, next, end, letters >> 5, length-1, depth+1);
+#else
+			const bool more = FollowChain(context, next, end, letters >> 5, length-1);
+#endif
 
-#if defined(NED_FLANDERS)
-	for (unsigned wordIdx : wordsFound)
-	{
-		const size_t length = strlen(s_words[wordIdx].word);
-//		const size_t length = s_words[wordIdx].word.length(); 
-		m_reqStrBufSize += length + 1; // Plus one for zero terminator
-	}
+			*next ^= kTileVisitedBit;
+#if defined(LETTER_HISTOGRAM)
+			context.OnLeave(letter);
 #endif
 
-#if defined(DEBUG_STATS)
-	if (s_threadInfo[iThread].load > 0)
-	{
-		const float hitPct = float(wordsFound.size())/s_threadInfo[iThread].load;
-		debug_print("Thread %u has max. traversal depth %u (max. %u), hit rate %.2f\n", iThread, m_maxDepth, s_longestWord, hitPct); 
+			if (false == more)
+				return false;
+		}
 	}
-#endif
+
+	return true;
 }
 
+#endif
+
+#else // ITERATIVE_TRAVERSAL
+
+// Same walk (and order) as the recursive version: a frame is pushed where TraverseBoard() would be called and popped
+// where it would return, at which point the parent gets to prune (as TraverseCall() would).
 #if defined(DEBUG_STATS)
-BOGGLE_INLINE_FORCE void Query::TraverseCall(std::vector<unsigned>& wordsFound, char* visited, DictionaryNode* node, unsigned width, unsigned height, unsigned iX, unsigned offsetY, uint8_t depth)
+void BOGGLE_INLINE Query::TraverseBoard(ThreadContext& context, char* visited, DictionaryNode* node, uint8_t depth)
 #else
-BOGGLE_INLINE_FORCE void Query::TraverseCall(std::vector<unsigned>& wordsFound, char* visited, DictionaryNode* node, unsigned width, unsigned height, unsigned iX, unsigned offsetY)
+void BOGGLE_INLINE Query::TraverseBoard(ThreadContext& context, char* visited, DictionaryNode* node)
 #endif
 {
-	if (!(*visited & kTileVisitedBit))
+	Assert(nullptr != node);
+
+	// Parents of the current node: one per letter (save for 'QU'), so never as deep as the longest word.
+	TraversalFrame stack[MAX_WORD_LEN];
+	TraversalFrame* parent = stack;
+
+	const int* neighbours = context.neighbours;
+
+	// Current frame, kept out of the stack so it can stay in registers.
+	int32_t wordIdx;
+	unsigned direction;
+
+	auto enter = [&]()
 	{
-		if (auto* child = node->GetChildChecked(*visited))
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		NodeState& state = context.GetState(node);
+		if (state.epoch != context.epoch)
 		{
+			// First touch this query.
+			state.epoch = context.epoch;
+			state.indexBits = node->HasChildren();
+		}
+
+		wordIdx = (state.indexBits & kWordFoundBit) ? -1 : node->GetWordIndex();
+#else
+		wordIdx = node->GetWordIndex();
+#endif
+
 #if defined(DEBUG_STATS)
-			TraverseBoard(wordsFound, visited, child, width, height, iX, offsetY, depth);
+		const unsigned frameDepth = unsigned(depth + (parent-stack) + 1);
+		Assert(frameDepth <= s_longestWord);
+		m_maxDepth = std::max<unsigned>(m_maxDepth, frameDepth);
+#endif
+
+#if defined(BIGRAM_MASK) || defined(NEIGHBOUR_MASKS)
+		// Skip straight to the end if none of what may follow can be next to this tile.
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		direction = context.CanContinue(visited, state.indexBits & ~kWordFoundBit) ? 0 : 8;
+#else
+		direction = context.CanContinue(visited, node->HasChildren()) ? 0 : 8;
+#endif
 #else
-			TraverseBoard(wordsFound, visited, child, width, height, iX, offsetY);
+		direction = 0;
 #endif
 
-			if (!child->HasChildren())
-				node->RemoveChild(*visited);
+#if defined(LETTER_HISTOGRAM)
+		context.OnVisit(*visited);
+#endif
+		*visited |= kTileVisitedBit;
+	};
+
+	enter();
+
+	for (;;)
+	{
+		if (direction < 8)
+		{
+			char* next = visited + neighbours[direction++];
+			if (*next & kTileVisitedBit)
+				continue;
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+			if (!(context.GetState(node).indexBits & (1 << *next)))
+				continue;
+
+			auto* child = node->GetChild(*next);
+#else
+			auto* child = node->GetChildChecked(*next);
+			if (nullptr == child)
+				continue;
+#endif
+
+#if defined(LETTER_HISTOGRAM)
+			if (false == context.CanFinish(child))
+				continue;
+#endif
+
+			Assert(parent < stack+MAX_WORD_LEN);
+			*parent++ = { visited, node, wordIdx, direction };
+
+			visited = next;
+			node = child;
+			enter();
+
+			continue;
 		}
-	}
-}
 
-#if defined(DEBUG_STATS)
-void BOGGLE_INLINE Query::TraverseBoard(std::vector<unsigned>& wordsFound, char* visited, DictionaryNode* node, unsigned width, unsigned height, unsigned iX, unsigned offsetY, uint8_t depth)
+		// Done!
+		*visited ^= kTileVisitedBit;
+#if defined(LETTER_HISTOGRAM)
+		context.OnLeave(*visited);
+#endif
+
+		if (0 == (wordIdx & ~0x7fffffff))
+		{
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+			context.GetState(node).indexBits |= kWordFoundBit;
+
+#if defined(BOARD_PARTITIONING)
+			if (true == context.Claim(wordIdx))
+#endif
+				context.wordsFound.emplace_back(wordIdx);
 #else
-void BOGGLE_INLINE Query::TraverseBoard(std::vector<unsigned>& wordsFound, char* visited, DictionaryNode* node, unsigned width, unsigned height, unsigned iX, unsigned offsetY)
+			node->OnWordFound();
+			context.OnNodeChanged(node);
+			context.wordsFound.emplace_back(wordIdx);
 #endif
-{
-	Assert(nullptr != node);
+		}
 
-	const auto wordIdx = node->GetWordIndex();
+		if (stack == parent)
+			break;
 
-#if defined(DEBUG_STATS)
-	++depth;
-	Assert(depth <= s_longestWord);
-	m_maxDepth = std::max<unsigned>(m_maxDepth, depth);
+		// Back in the parent: anything left down there?
+		auto* done = node;
+		const unsigned letter = *visited;
+
+		--parent;
+		visited   = parent->visited;
+		node      = parent->node;
+		wordIdx   = parent->wordIdx;
+		direction = parent->direction;
+
+#if defined(NON_DESTRUCTIVE_TRAVERSAL)
+		if (!(context.GetState(done).indexBits & ~kWordFoundBit))
+			context.GetState(node).indexBits ^= 1 << letter;
+#else
+		if (!done->HasChildren())
+		{
+			node->RemoveChild(letter);
+			context.OnNodeChanged(node);
+		}
 #endif
+	}
+}
 
-	// Flag tile as visited while we traverse in search of a word (the branch predictor does a good enough job below).
-	*visited |= kTileVisitedBit;
+#endif // ITERATIVE_TRAVERSAL
+
+#if defined(NEIGHBOUR_MASKS)
+
+// Per tile of a sanitized board (same layout, border included), the letters next to it; allocated on the global heap.
+// Returns nullptr if the board is too large.
+static uint32_t* GetNeighbourMasks(const char* sanitized, unsigned width, unsigned height)
+{
+	if (size_t(width)*height > NEIGHBOUR_MASKS_MAX_SIZE)
+		return nullptr;
 
 #if defined(DEBUG_STATS)
-	// Not touching this unless I have to, see '#else'.
-	if (offsetY >= width) 
-	{
-		if (iX < width-1) 
-			TraverseCall(wordsFound, (visited - width) + 1, node, width, height, iX+1, offsetY-width, depth);
+	const auto start = std::chrono::high_resolution_clock::now();
+#endif
 
-		TraverseCall(wordsFound, visited - width, node, width, height, iX, offsetY-width, depth);
-		
-		if (iX > 0) 
-			TraverseCall(wordsFound, (visited - width) - 1, node, width, height, iX-1, offsetY-width, depth);
-	}
+	const size_t gridSize = GetPaddedGridSize(width, height);
+	uint32_t* neighbourMasks = static_cast<uint32_t*>(s_globalCustomAlloc.AllocateAlignedUnsafe(gridSize*sizeof(uint32_t), kAlignTo));
 
-	if (iX > 0)
-		TraverseCall(wordsFound, visited-1, node, width, height, iX-1, offsetY, depth);
+	const int pitch = int(width+2);
+	const int neighbours[8] = { 1-pitch, -pitch, -1-pitch, -1, 1, pitch+1, pitch, pitch-1 };
 
-	if (iX < width-1) 
-		TraverseCall(wordsFound, visited+1, node, width, height, iX+1, offsetY, depth);
+	// From the first tile to the last (border tiles in between get one too, it's just never used), 4 at a time as long 
+	// as all neighbours are on the grid.
+	const size_t first = size_t(pitch)+1, last = size_t(pitch)*(height+1) - 2;
 
-	if (offsetY < width*(height-1))
+	size_t index = first;
+	for (; index+4 <= last; index += 4)
 	{
-		if (iX < width-1) 
-			TraverseCall(wordsFound, (visited + width) + 1, node, width, height, iX+1, offsetY+width, depth);
+		const char* tiles = sanitized+index;
 
-		TraverseCall(wordsFound, visited + width, node, iX, width, height, offsetY+width, depth);
+		__m128i adjacent = GetLetterBits(tiles+neighbours[0]);
+		for (unsigned iNeighbour = 1; iNeighbour < 8; ++iNeighbour)
+			adjacent = _mm_or_si128(adjacent, GetLetterBits(tiles+neighbours[iNeighbour]));
 
-		if (iX > 0) 
-			TraverseCall(wordsFound, (visited + width) - 1, node, width, height, iX-1, offsetY+width, depth);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(neighbourMasks+index), adjacent);
 	}
-#else
-	// Traverse backwards first, hoping that maybe some is still retained in one of the cache levels.
-	if (offsetY >= width) 
-	{
-		if (iX < width-1) 
-			TraverseCall(wordsFound, (visited - width) + 1, node, width, height, iX+1, offsetY-width);
 
-		TraverseCall(wordsFound, visited - width, node, width, height, iX, offsetY-width);
+	for (; index <= last; ++index)
+	{
+		uint32_t adjacent = 0;
+		for (const int offset : neighbours)
+		{
+			const unsigned neighbour = uint8_t(sanitized[ptrdiff_t(index)+offset]);
+			if (neighbour < kAlphaRange+USE_EXTRA_INDEX)
+				adjacent |= 1 << neighbour;
+		}
 
-		if (iX > 0) 
-			TraverseCall(wordsFound, (visited - width) - 1, node, width, height, iX-1, offsetY-width);
+		neighbourMasks[index] = adjacent;
 	}
 
-	if (iX > 0)
-		TraverseCall(wordsFound, visited-1, node, width, height, iX-1, offsetY);
+#if defined(DEBUG_STATS)
+	const auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	debug_print("Neighbour masks for %ux%u board took %lld microsec.\n", width, height, (long long) time.count());
+#endif
+
+	return neighbourMasks;
+}
+
+#endif
+
+// Copies the board to the global heap (which must have been reset), with each tile as a letter index and a border
+// around it (see kTileBorder). Returns nullptr if there's anything but letters on it (only checked with NED_FLANDERS).
+static char* SanitizeBoard(const char* board, unsigned width, unsigned height)
+{
+	const size_t gridSize = GetPaddedGridSize(width, height);
+	const unsigned pitch = width+2;
+
+#ifdef NED_FLANDERS
+	char* sanitized = static_cast<char*>(s_globalCustomAlloc.AllocateAligned(gridSize*sizeof(char), kAlignTo));
 
-	if (iX < width-1) 
-		TraverseCall(wordsFound, visited+1, node, width, height, iX+1, offsetY);
+	bool invalidBoard = false;
 
-	if (offsetY < width*(height-1))
+	// Sanitize that checks for illegal input and uppercases.
+	for (unsigned iY = 0; iY < height; ++iY)
 	{
-		if (iX < width-1) 
-			TraverseCall(wordsFound, (visited + width) + 1, node, width, height, iX+1, offsetY+width);
+		#pragma omp parallel for num_threads(4)
+		for (int iX = 0; iX < int(width); ++iX)
+		{
+			const unsigned index = iY*width + iX;
+
+			// FIXME: does not check for 'u'!
+			const char letter = board[index];
+			if (0 != isalpha((unsigned char) letter))
+			{
+				const unsigned sanity = LetterToIndex(toupper(letter));
+				sanitized[(iY+1)*pitch + iX+1] = sanity;
+			}
+			else
+			{
+				// Invalid character: skip query.
+				invalidBoard = true;
+				break;				}
+		}
+	}
+
+	if (true == invalidBoard)
+		return nullptr;
+#else
+	char* sanitized = static_cast<char*>(s_globalCustomAlloc.AllocateAlignedUnsafe(gridSize, kAlignTo));
 
-		TraverseCall(wordsFound, visited + width, node, width, height, iX, offsetY+width);
+	// Sanitize that just reorders and expects uppercase.
+	for (unsigned iY = 0; iY < height; ++iY)
+	{
+		const char* row = board + size_t(iY)*width;
+		char* sanitizedRow = sanitized + size_t(iY+1)*pitch + 1;
 
-		if (iX > 0) 
-			TraverseCall(wordsFound, (visited + width) - 1, node, width, height, iX-1, offsetY+width);
+		#pragma omp simd
+		for (int iX = 0; iX < int(width); ++iX)
+		{
+			sanitizedRow[iX] = (row[iX] - 'A') + USE_EXTRA_INDEX; // LetterToIndex(board[index]); // FIXME: may need a 'toupper()' depending on the harness
+		}
 	}
 #endif
-	
-	// Way too close, after an inspection of the assembly.
-//	ClosePrefetch(reinterpret_cast<char*>(node));
-
-	// Done!
-	*visited ^= kTileVisitedBit;
 
-	if (wordIdx & ~0x7fffffff) 
-		return;
+	// Border: top and bottom row, then the sides.
+	memset(sanitized, kTileBorder, pitch);
+	memset(sanitized + size_t(height+1)*pitch, kTileBorder, pitch);
+	for (unsigned iY = 1; iY <= height; ++iY)
+	{
+		sanitized[size_t(iY)*pitch] = kTileBorder;
+		sanitized[size_t(iY)*pitch + width+1] = kTileBorder;
+	}
 
-//	if (0 == (wordIdx & ~0x7fffffff)) {} 
-	node->OnWordFound();
-	wordsFound.emplace_back(wordIdx);
+	return sanitized;
 }
 
 Results FindWords(const char* board, unsigned width, unsigned height)
@@ -994,84 +5888,133 @@ Results FindWords(const char* board, unsigned width, unsigned height)
 	results.Score = 0;
 	results.UserData = nullptr; // Didn't need it in this implementation.
 
-	// Board parameters check out?
-	if (nullptr != board && !(0 == width || 0 == height))
+	// Board parameters (and dictionary) check out?
+	if (nullptr != board && !(0 == width || 0 == height) && nullptr != s_workerPool)
 	{
 		s_globalCustomAlloc.Reset(GLOBAL_MEMORY_POOL_SIZE);
 
-		const unsigned gridSize = width*height;
+		char* sanitized = SanitizeBoard(board, width, height);
+		if (nullptr == sanitized)
+			return results; // Invalid board: skip query (no results).
 
-#ifdef NED_FLANDERS
-		char* sanitized = static_cast<char*>(s_globalCustomAlloc.AllocateAligned(gridSize*sizeof(char), kAlignTo));
+//		debug_print("Total allocation from global heap before query: %zu\n", s_globalCustomAlloc.GetApproxLoad());
+
+		// Per-thread heaps are managed by the workers themselves (see ResetThreadHeap()).
+		Query query(results, sanitized, width, height);
+#if defined(NEIGHBOUR_MASKS)
+		query.SetNeighbourMasks(GetNeighbourMasks(sanitized, width, height));
+#endif
+		query.Execute();
+
+#if defined(NED_FLANDERS)
+		// There's really no point in doing this, since I'm resetting the global (custom) heap on the next FindWords() call
+		s_globalCustomAlloc.Free(sanitized);
+#endif
+	}
+
+	return results;
+}
+
+void FindWordsBatch(const char* const* boards, const unsigned* widths, const unsigned* heights, unsigned count, Results* out)
+{
+	for (unsigned iBoard = 0; iBoard < count; ++iBoard)
+	{
+		out[iBoard].Words = nullptr;
+		out[iBoard].Count = 0;
+		out[iBoard].Score = 0;
+		out[iBoard].UserData = nullptr;
+	}
+
+	if (0 == count || nullptr == s_workerPool)
+		return;
+
+#if defined(NED_FLANDERS)
+	DictionaryLock dictLock;
+#endif
+
+	// Once for the whole batch, as is sanitizing.
+	s_globalCustomAlloc.Reset(GLOBAL_MEMORY_POOL_SIZE);
+
+	std::vector<const char*> sanitized(count, nullptr);
+	std::vector<BoardLetters> letters(count);
+#if defined(NEIGHBOUR_MASKS)
+	std::vector<const uint32_t*> neighbourMasks(count, nullptr);
+#endif
 
-		bool invalidBoard = false;
+	Batch batch;
+	batch.results = out;
+	batch.sanitized = sanitized.data();
+#if defined(NEIGHBOUR_MASKS)
+	batch.neighbourMasks = neighbourMasks.data();
+#endif
+	batch.letters = letters.data();
+	batch.widths = widths;
+	batch.heights = heights;
+	batch.count = count;
+	batch.maxGridSize = 0;
 
-		// Sanitize that checks for illegal input and uppercases.
-		for (unsigned iY = 0; iY < height; ++iY)
+	for (unsigned iBoard = 0; iBoard < count; ++iBoard)
+	{
+		const unsigned width = widths[iBoard], height = heights[iBoard];
+		if (nullptr != boards[iBoard] && !(0 == width || 0 == height))
 		{
-			#pragma omp parallel for num_threads(4)
-			for (int iX = 0; iX < int(width); ++iX)
+			sanitized[iBoard] = SanitizeBoard(boards[iBoard], width, height); // Skipped if invalid
+			if (nullptr != sanitized[iBoard])
 			{
-				const unsigned index = iY*width + iX;
+				// Once here instead of once per thread.
+				letters[iBoard].Find(sanitized[iBoard], width, height);
 
-				// FIXME: does not check for 'u'!
-				const char letter = board[index];
-				if (0 != isalpha((unsigned char) letter))
-				{
-					const unsigned sanity = LetterToIndex(toupper(letter));
-					sanitized[index] = sanity;
-				}
-				else
-				{
-					// Invalid character: skip query.
-					invalidBoard = true;
-					break;				}
+#if defined(NEIGHBOUR_MASKS)
+				neighbourMasks[iBoard] = GetNeighbourMasks(sanitized[iBoard], width, height);
+#endif
 			}
+			batch.maxGridSize = std::max<size_t>(batch.maxGridSize, GetPaddedGridSize(width, height));
 		}
+	}
 
-		if (true == invalidBoard)
-			return results; // Skip query: no results.
-#else
-		char* sanitized = static_cast<char*>(s_globalCustomAlloc.AllocateAlignedUnsafe(gridSize, kAlignTo));
+	if (0 == batch.maxGridSize)
+		return;
 
-		// Sanitize that just reorders and expects uppercase.
-		#pragma omp simd
-		for (int index = 0; index < int(gridSize); ++index)
-		{
-			sanitized[index] = (board[index] - 'A') + USE_EXTRA_INDEX; // LetterToIndex(board[index]); // FIXME: may need a 'toupper()' depending on the harness
-		}
-#endif
+	batch.wordsEnd.resize(kNumThreads*size_t(count));
 
-		// Allocate for per-thread allocators
-		const size_t overhead = tlsf_alloc_overhead();
-		s_threadCustomAlloc.reserve(kNumThreads);
-		for (auto iThread = 0; iThread < kNumThreads; ++iThread)
-		{
-			const size_t threadHeapSize = 
-				gridSize*sizeof(char) + overhead +                              // Visited grid
-				s_threadInfo[iThread].nodes*sizeof(DictionaryNode) + overhead + // Dictionary nodes
-				1024*1024; // Overhead
+	// Every worker runs through all boards on it's own, so there's no synchronization between boards, only at the end.
+	s_workerPool->Run([](void* batch, unsigned iThread) 
+	{ 
+		Query::ExecuteBatchThread(*static_cast<Batch*>(batch), iThread, s_threadWordsFound[iThread]); 
+	}, &batch);
 
-			s_threadCustomAlloc.emplace_back(CustomAlloc(static_cast<char*>(s_globalCustomAlloc.AllocateAlignedUnsafe(threadHeapSize, kPageSize)), threadHeapSize));
-		}
+	// Gather on the calling thread, allocating just what each board needs.
+	for (unsigned iBoard = 0; iBoard < count; ++iBoard)
+	{
+		if (nullptr == sanitized[iBoard])
+			continue;
 
-//		debug_print("Total allocation from global heap before query: %zu\n", s_globalCustomAlloc.GetApproxLoad());
+		size_t numWords = 0;
+		for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+		{
+			const size_t* wordsEnd = &batch.wordsEnd[iThread*size_t(count)];
+			numWords += wordsEnd[iBoard] - (iBoard > 0 ? wordsEnd[iBoard-1] : 0);
+		}
 
-		Query query(results, sanitized, width, height);
-		query.Execute();
+		Results& results = out[iBoard];
+		results.Words = static_cast<char**>(mallocAligned(std::max<size_t>(numWords, 1)*sizeof(char*), kAlignTo));
+		char** words_cstr = const_cast<char**>(results.Words);
 
-#if defined(NED_FLANDERS)
-		// There's really no point in doing this, since I'm resetting the global (custom) heap on the next FindWords() call
-		for (auto& allocator : s_threadCustomAlloc)
-			s_globalCustomAlloc.Free(allocator.GetPool());
+		for (unsigned iThread = 0; iThread < kNumThreads; ++iThread)
+		{
+			const size_t* wordsEnd = &batch.wordsEnd[iThread*size_t(count)];
+			const auto& wordsFound = s_threadWordsFound[iThread];
 
-			s_globalCustomAlloc.Free(sanitized);
-#endif
+			for (size_t iWord = (iBoard > 0 ? wordsEnd[iBoard-1] : 0); iWord < wordsEnd[iBoard]; ++iWord)
+			{
+				const auto& word = s_wordTable[wordsFound[iWord]];
 
-		s_threadCustomAlloc.clear();
+				++results.Count;
+				results.Score += unsigned(word.score);
+				*words_cstr++ = const_cast<char*>(word.word);
+			}
+		}
 	}
-
-	return results;
 }
 
 void FreeWords(Results results)
@@ -5,6 +5,36 @@
 // #define DUPE_CHECK
 #define PRINT_ITER_RESULTS
 
+// Load (or first compile, if need be) a dictionary image instead of parsing text.
+// #define DICTIONARY_IMAGE "dictionary.img"
+
+// Just load both dictionaries a few times, print how long each load took and quit.
+// Build with SCALAR_DICTIONARY_PARSER (see solver.cpp) to compare against the old fgetc() loop.
+// #define DICTIONARY_LOAD_BENCHMARK
+
+// Solve this many boards (of the size given on the command line) per FindWordsBatch() call, report boards per second
+// (against FindWords() one at a time) and quit.
+// #define BATCH_BENCHMARK 1000
+
+// Solve the board (of the size given on the command line) a few times with the dictionary trie and then with the prefix
+// hash (see UsePrefixHash()), report the fastest run of each and quit.
+// #define PREFIX_HASH_BENCHMARK
+
+// Solve a 1k, 4k and 16k square board once each and quit; the number of workers follows the affinity mask,
+// so run it under 'taskset -c 0-<N-1>' for N = 1, 2, 4.. to see how it scales (build with BOARD_PARTITIONING, see solver.cpp).
+// #define LARGE_BOARD_BENCHMARK
+
+// Report what the dictionary takes (resident, so build with LOUDS_TRIE, see solver.cpp, to compare) and the best query time
+// on a few board sizes, and quit.
+// #define MEMORY_BENCHMARK
+
+// Solve a few boards (of the size given on the command line) every way this build can: each kernel SIMD_NEIGHBOURS has
+// (see solver.cpp) that this CPU runs, FindWordsBatch(), the prefix hash (see UsePrefixHash()) and a dictionary image.
+// Check they all find the very same words as plain FindWords() does (looking at every neighbour), and quit (non-zero if
+// not). Those words are written to this file, or checked against it if it's there, so that a build with another backend
+// (DOUBLE_ARRAY_TRIE, DAWG_DICTIONARY or LOUDS_TRIE) can be checked against one without: run that one second.
+// #define WORD_SET_CHECK "word-sets.txt"
+
 // When board randomization enabled, it pays off (usually) to do more queries to get better performance.
 #ifdef _WIN32
 	#define HIGHSCORE_LOOP
@@ -28,6 +58,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <time.h>
+#include <ctype.h>
 
 #include <memory>
 #include <chrono>
@@ -43,6 +74,173 @@
 	#include <windows.h>
 #endif
 
+#if defined(MEMORY_BENCHMARK)
+	#if defined(_WIN32)
+		#include <psapi.h>
+	#elif defined(__APPLE__)
+		#include <mach/mach.h>
+	#endif
+
+// Resident memory of this process (now and at it's peak) in KB.
+static void GetResidentMemory(size_t& current, size_t& peak)
+{
+	current = peak = 0;
+
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		current = counters.WorkingSetSize/1024;
+		peak = counters.PeakWorkingSetSize/1024;
+	}
+#elif defined(__APPLE__)
+	mach_task_basic_info info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (KERN_SUCCESS == task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count))
+	{
+		current = info.resident_size/1024;
+		peak = info.resident_size_max/1024;
+	}
+#else
+	FILE* file = fopen("/proc/self/status", "r");
+	if (nullptr != file)
+	{
+		char line[256];
+		while (nullptr != fgets(line, sizeof(line), file))
+		{
+			sscanf(line, "VmRSS: %zu", &current);
+			sscanf(line, "VmHWM: %zu", &peak);
+		}
+
+		fclose(file);
+	}
+#endif
+}
+
+#endif
+
+#if defined(WORD_SET_CHECK)
+
+// A board's words, sorted (as not every way to find them yields the same order).
+static std::vector<std::string> GetWordSet(const Results& results)
+{
+	std::vector<std::string> words;
+	words.reserve(results.Count);
+
+	for (unsigned iWord = 0; iWord < results.Count; ++iWord)
+	{
+		const char* word = results.Words[iWord];
+
+		size_t length = 0;
+		while (isalpha(word[length]))
+			++length;
+
+		words.emplace_back(word, length);
+	}
+
+	std::sort(words.begin(), words.end());
+	return words;
+}
+
+// Per board, FindWords() one at a time.
+static std::vector<std::vector<std::string>> FindWordSets(const std::vector<const char*>& boards, unsigned width, unsigned height)
+{
+	std::vector<std::vector<std::string>> wordSets;
+	for (const char* board : boards)
+	{
+		Results results = FindWords(board, width, height);
+		wordSets.emplace_back(GetWordSet(results));
+		FreeWords(results);
+	}
+
+	return wordSets;
+}
+
+// Per board, the lot at once.
+static std::vector<std::vector<std::string>> FindWordSetsBatch(const std::vector<const char*>& boards, unsigned width, unsigned height)
+{
+	const unsigned count = unsigned(boards.size());
+	const std::vector<unsigned> widths(count, width), heights(count, height);
+	std::vector<Results> results(count);
+
+	FindWordsBatch(boards.data(), widths.data(), heights.data(), count, results.data());
+
+	std::vector<std::vector<std::string>> wordSets;
+	for (auto& boardResults : results)
+	{
+		wordSets.emplace_back(GetWordSet(boardResults));
+		FreeWords(boardResults);
+	}
+
+	return wordSets;
+}
+
+// Writes 'wordSets' (of boards 'width' by 'height') to 'path': a header, then per board it's word count and words, a line each.
+static bool WriteWordSets(const char* path, unsigned width, unsigned height, const std::vector<std::vector<std::string>>& wordSets)
+{
+	FILE* file = fopen(path, "w");
+	if (nullptr == file)
+		return false;
+
+	fprintf(file, "%u %u %zu\n", width, height, wordSets.size());
+	for (const auto& words : wordSets)
+	{
+		fprintf(file, "%zu\n", words.size());
+		for (const auto& word : words)
+			fprintf(file, "%s\n", word.c_str());
+	}
+
+	fclose(file);
+	return true;
+}
+
+// Reads what WriteWordSets() wrote to 'path', if it's there and for as many boards of 'width' by 'height'.
+static bool ReadWordSets(const char* path, unsigned width, unsigned height, size_t numBoards, std::vector<std::vector<std::string>>& wordSets)
+{
+	FILE* file = fopen(path, "r");
+	if (nullptr == file)
+		return false;
+
+	unsigned fileWidth = 0, fileHeight = 0;
+	size_t fileBoards = 0;
+	bool valid = 3 == fscanf(file, "%u %u %zu", &fileWidth, &fileHeight, &fileBoards) && fileWidth == width && fileHeight == height && fileBoards == numBoards;
+
+	wordSets.assign(numBoards, std::vector<std::string>());
+	for (size_t iBoard = 0; iBoard < numBoards && true == valid; ++iBoard)
+	{
+		size_t count = 0;
+		valid = 1 == fscanf(file, "%zu", &count);
+
+		char word[256];
+		for (size_t iWord = 0; iWord < count && true == valid; ++iWord)
+		{
+			valid = 1 == fscanf(file, "%255s", word);
+			wordSets[iBoard].emplace_back(word);
+		}
+	}
+
+	fclose(file);
+	return valid;
+}
+
+// Says whether 'wordSets' is the same as 'reference' (board by board), and returns it.
+static bool CheckWordSets(const char* name, const std::vector<std::vector<std::string>>& reference, const std::vector<std::vector<std::string>>& wordSets)
+{
+	for (size_t iBoard = 0; iBoard < reference.size(); ++iBoard)
+	{
+		if (wordSets[iBoard] != reference[iBoard])
+		{
+			printf("%s: words differ on board %zu (%zu found, %zu expected).\n", name, iBoard, wordSets[iBoard].size(), reference[iBoard].size());
+			return false;
+		}
+	}
+
+	printf("%s: same words.\n", name);
+	return true;
+}
+
+#endif
+
 // #include "timing.h"
 
 int main(int argC, char **arguments)
@@ -64,6 +262,78 @@ int main(int argC, char **arguments)
 
 	initialize_random_generator();
 
+#if defined(DICTIONARY_LOAD_BENCHMARK)
+	for (const char* path : { "dictionary.txt", "dictionary-bigger.txt" })
+	{
+		printf("- Loading %s...\n", path);
+		for (unsigned iLoad = 0; iLoad < 5; ++iLoad)
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			LoadDictionary(path);
+			const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+
+			printf("Load %u: %lld microsec.\n", iLoad+1, (long long) duration.count());
+		}
+	}
+
+	FreeDictionary();
+	return 0;
+#endif
+
+#if defined(MEMORY_BENCHMARK)
+	{
+		size_t before, peak;
+		GetResidentMemory(before, peak);
+
+		printf("- Loading dictionary.txt...\n");
+		LoadDictionary("dictionary.txt");
+
+		size_t loaded;
+		GetResidentMemory(loaded, peak);
+		printf("Dictionary: %zu KB resident (%zu KB at peak, while loading).\n", loaded-before, peak-before);
+
+		for (const unsigned side : { 4u, 10u, 100u })
+		{
+			std::vector<char> grid(size_t(side)*side);
+			for (auto& character : grid)
+			{
+				int random;
+				do
+				{
+					random = mt_randu32() % 26;
+				}
+				while (random == 'U' - 'A'); // No 'U'
+				character = 'A' + random;
+			}
+
+			std::chrono::microseconds fastest(10000000);
+			unsigned count = 0;
+			for (unsigned iQuery = 0; iQuery < 2000/side; ++iQuery)
+			{
+				const auto start = std::chrono::high_resolution_clock::now();
+				Results results = FindWords(grid.data(), side, side);
+				const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+
+				if (duration < fastest)
+					fastest = duration;
+
+				count = results.Count;
+				FreeWords(results);
+			}
+
+			printf("%ux%u: %.lld microsec. (Count %u)\n", side, side, fastest.count(), count);
+		}
+
+		// Thread heaps and such included.
+		size_t queried;
+		GetResidentMemory(queried, peak);
+		printf("After querying: %zu KB resident (%zu KB at peak), %zu KB for the whole process.\n", queried-before, peak-before, queried);
+
+		FreeDictionary();
+		return 0;
+	}
+#endif
+
 	std::chrono::microseconds curFastest(10000000); // Just needed something 'big'
 	std::chrono::microseconds prevFastest(curFastest);
 
@@ -74,7 +344,45 @@ int main(int argC, char **arguments)
 	// const char *dictPath = "dictionary-short.txt";
 	const char *dictPath = "dictionary.txt";
 	//	const char *dictPath = "dictionary-bigger.txt";
+#if defined(DICTIONARY_IMAGE)
+	const auto loadStart = std::chrono::high_resolution_clock::now();
+	if (false == LoadDictionaryImage(DICTIONARY_IMAGE))
+	{
+		printf("- No (valid) image, compiling %s...\n", DICTIONARY_IMAGE);
+		if (false == CompileDictionaryImage(dictPath, DICTIONARY_IMAGE))
+			LoadDictionary(dictPath); // Not every build can
+	}
+	printf("- Loading took %lld microsec.\n", (long long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - loadStart).count());
+#else
 	LoadDictionary(dictPath);
+#endif
+
+#if defined(LARGE_BOARD_BENCHMARK)
+	for (const unsigned side : { 1024u, 4096u, 16384u })
+	{
+		std::vector<char> grid(size_t(side)*side);
+		for (auto& character : grid)
+		{
+			int random;
+			do
+			{
+				random = mt_randu32() % 26;
+			}
+			while (random == 'U' - 'A'); // No 'U'
+			character = 'A' + random;
+		}
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		Results results = FindWords(grid.data(), side, side);
+		const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+
+		printf("%ux%u: %.lld microsec. (Count %u, Score %u)\n", side, side, duration.count(), results.Count, results.Score);
+		FreeWords(results);
+	}
+
+	FreeDictionary();
+	return 0;
+#endif
 
 #ifndef USE_UNITY_REF_GRID
 
@@ -133,6 +441,178 @@ GenerateBoard:
 
 #endif
 
+#if defined(BATCH_BENCHMARK)
+	{
+		// Generated just like the board above.
+		std::vector<char> batchGrids(size_t(BATCH_BENCHMARK)*gridSize);
+		for (auto& character : batchGrids)
+		{
+			int random;
+			do
+			{
+				random = mt_randu32() % 26;
+			}
+			while (random == 'U' - 'A'); // No 'U'
+			character = 'A' + random;
+		}
+
+		std::vector<const char*> boards(BATCH_BENCHMARK);
+		for (unsigned iBoard = 0; iBoard < BATCH_BENCHMARK; ++iBoard)
+			boards[iBoard] = batchGrids.data() + size_t(iBoard)*gridSize;
+
+		const std::vector<unsigned> widths(BATCH_BENCHMARK, xSize), heights(BATCH_BENCHMARK, ySize);
+		std::vector<Results> batchResults(BATCH_BENCHMARK);
+
+		printf("- Batches of %u boards (%ux%u)...\n", (unsigned) BATCH_BENCHMARK, xSize, ySize);
+
+		std::chrono::microseconds batchFastest(curFastest);
+		for (unsigned iRun = 0; iRun < 5; ++iRun)
+		{
+			if (0 != iRun)
+			{
+				for (auto& results : batchResults)
+					FreeWords(results);
+			}
+
+			const auto start = std::chrono::high_resolution_clock::now();
+			FindWordsBatch(boards.data(), widths.data(), heights.data(), BATCH_BENCHMARK, batchResults.data());
+			const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+
+			if (duration < batchFastest)
+				batchFastest = duration;
+		}
+
+		// Same boards, one at a time (and they'd better agree).
+		unsigned mismatches = 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned iBoard = 0; iBoard < BATCH_BENCHMARK; ++iBoard)
+		{
+			Results results = FindWords(boards[iBoard], xSize, ySize);
+			if (results.Count != batchResults[iBoard].Count || results.Score != batchResults[iBoard].Score)
+				++mismatches;
+
+			FreeWords(results);
+		}
+		const auto single = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+
+		for (auto& results : batchResults)
+			FreeWords(results);
+
+		printf("Batched: %.0lf boards/sec., one by one: %.0lf boards/sec. (%u mismatches)\n", 
+			BATCH_BENCHMARK*1000000.0/std::max<long long>(1, batchFastest.count()), BATCH_BENCHMARK*1000000.0/std::max<long long>(1, single.count()), mismatches);
+
+		FreeDictionary();
+		return 0;
+	}
+#endif
+
+#if defined(WORD_SET_CHECK)
+	{
+		constexpr unsigned kNumBoards = 8;
+
+		// The board above and a few more, generated just like it.
+		std::vector<char> grids(size_t(kNumBoards-1)*gridSize);
+		for (auto& character : grids)
+		{
+			int random;
+			do
+			{
+				random = mt_randu32() % 26;
+			}
+			while (random == 'U' - 'A'); // No 'U'
+			character = 'A' + random;
+		}
+
+		std::vector<const char*> boards(1, board.get());
+		for (unsigned iBoard = 1; iBoard < kNumBoards; ++iBoard)
+			boards.emplace_back(grids.data() + size_t(iBoard-1)*gridSize);
+
+		printf("- Checking the words found on %u boards (%ux%u)...\n", kNumBoards, xSize, ySize);
+
+		// Against every neighbour, one by one.
+		UseNeighbourKernel("none");
+		const auto reference = FindWordSets(boards, xSize, ySize);
+
+		bool same = true;
+		for (const char* kernel : { "sse2", "avx2", "avx512f" })
+		{
+			if (true == UseNeighbourKernel(kernel))
+				same &= CheckWordSets(kernel, reference, FindWordSets(boards, xSize, ySize));
+			else
+				printf("%s: built without SIMD_NEIGHBOURS (see solver.cpp) or not supported by this CPU.\n", kernel);
+		}
+
+		UseNeighbourKernel(nullptr);
+
+		same &= CheckWordSets("FindWordsBatch()", reference, FindWordSetsBatch(boards, xSize, ySize));
+
+		if (true == UsePrefixHash(true))
+		{
+			same &= CheckWordSets("Prefix hash", reference, FindWordSets(boards, xSize, ySize));
+			same &= CheckWordSets("Prefix hash, FindWordsBatch()", reference, FindWordSetsBatch(boards, xSize, ySize));
+			UsePrefixHash(false);
+		}
+		else
+			printf("Prefix hash: built without PREFIX_HASH_ENGINE (see solver.cpp).\n");
+
+		// Another build (backend) may have been here first.
+		std::vector<std::vector<std::string>> previous;
+		if (true == ReadWordSets(WORD_SET_CHECK, xSize, ySize, boards.size(), previous))
+			same &= CheckWordSets(WORD_SET_CHECK, reference, previous);
+		else if (true == WriteWordSets(WORD_SET_CHECK, xSize, ySize, reference))
+			printf("%s: written (missing, or for other boards).\n", WORD_SET_CHECK);
+
+		// Last, as it leaves the dictionary loaded from the image.
+		const char* imagePath = "word-set-check.img";
+		if (true == CompileDictionaryImage(dictPath, imagePath) && true == LoadDictionaryImage(imagePath))
+			same &= CheckWordSets("Dictionary image", reference, FindWordSets(boards, xSize, ySize));
+		else
+			printf("Dictionary image: not supported by this build.\n");
+
+		remove(imagePath);
+
+		FreeDictionary();
+		return true == same ? 0 : 1;
+	}
+#endif
+
+#if defined(PREFIX_HASH_BENCHMARK)
+	{
+		printf("- Dictionary trie against prefix hash (%ux%u)...\n", xSize, ySize);
+
+		for (const bool usePrefixHash : { false, true })
+		{
+			if (false == UsePrefixHash(usePrefixHash))
+			{
+				printf("Built without PREFIX_HASH_ENGINE (see solver.cpp).\n");
+				break;
+			}
+
+			std::chrono::microseconds fastest(curFastest);
+			unsigned count = 0, score = 0;
+			for (unsigned iRun = 0; iRun < 10; ++iRun)
+			{
+				const auto start = std::chrono::high_resolution_clock::now();
+				Results results = FindWords(board.get(), xSize, ySize);
+				const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+
+				if (duration < fastest)
+					fastest = duration;
+
+				count = results.Count;
+				score = results.Score;
+				FreeWords(results);
+			}
+
+			printf("%s: %.lld microsec. (Count %u, Score %u)\n", usePrefixHash ? "Prefix hash" : "Trie", fastest.count(), count, score);
+		}
+
+		UsePrefixHash(false);
+		FreeDictionary();
+		return 0;
+	}
+#endif
+
 #ifdef HIGHSCORE_LOOP
 	printf("- Finding (looping for high score!) in %ux%u... (%u iterations per run)\n", xSize, ySize, NUM_QUERIES);
 #else
@@ -0,0 +1,110 @@
+/*
+	Chase-Lev work-stealing deque (as corrected for weak memory models by Lê et al., 2013), bounded.
+
+	The owner pushes and pops at the bottom (LIFO), anyone else steals from the top (FIFO); only the
+	last remaining item is contended for. Pushing more than the capacity given to Reset() is not allowed,
+	as nothing here grows the buffer.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+
+#include "inline.h"
+
+template<typename T> class WorkStealingDeque
+{
+public:
+	enum class Steal
+	{
+		kSuccess,
+		kEmpty,
+		kLostRace // Try again (or elsewhere)
+	};
+
+	WorkStealingDeque() {}
+	~WorkStealingDeque() {}
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	// Empties it; only when no one else is looking (e.g. before the workers are kicked off).
+	void Reset(size_t capacity)
+	{
+		if (capacity > m_capacity)
+		{
+			m_capacity = 1;
+			while (m_capacity < capacity)
+				m_capacity <<= 1;
+
+			m_buffer = std::make_unique<std::atomic<T>[]>(m_capacity);
+		}
+
+		m_top.store(0, std::memory_order_relaxed);
+		m_bottom.store(0, std::memory_order_relaxed);
+	}
+
+	// Owner only.
+	BOGGLE_INLINE void Push(T item)
+	{
+		const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+
+		m_buffer[bottom & (m_capacity-1)].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(bottom+1, std::memory_order_relaxed);
+	}
+
+	// Owner only.
+	BOGGLE_INLINE bool Pop(T& item)
+	{
+		const int64_t bottom = m_bottom.load(std::memory_order_relaxed)-1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = m_top.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			// Was empty.
+			m_bottom.store(bottom+1, std::memory_order_relaxed);
+			return false;
+		}
+
+		item = m_buffer[bottom & (m_capacity-1)].load(std::memory_order_relaxed);
+		if (top < bottom)
+			return true;
+
+		// Last one: race the thieves for it.
+		const bool won = m_top.compare_exchange_strong(top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(bottom+1, std::memory_order_relaxed);
+		return won;
+	}
+
+	// Anyone.
+	BOGGLE_INLINE Steal TrySteal(T& item)
+	{
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+		if (top >= bottom)
+			return Steal::kEmpty;
+
+		item = m_buffer[top & (m_capacity-1)].load(std::memory_order_relaxed);
+		if (false == m_top.compare_exchange_strong(top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return Steal::kLostRace;
+
+		return Steal::kSuccess;
+	}
+
+private:
+	// Thieves hammer 'm_top', the owner 'm_bottom': keep them apart.
+	alignas(64) std::atomic<int64_t> m_top = 0;
+	alignas(64) std::atomic<int64_t> m_bottom = 0;
+
+	alignas(64) std::unique_ptr<std::atomic<T>[]> m_buffer;
+	size_t m_capacity = 0;
+};
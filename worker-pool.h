@@ -0,0 +1,204 @@
+/*
+	Persistent worker pool: one (pinned) thread per worker that spins for a while after finishing a job and then parks,
+	so back-to-back queries don't pay for thread creation or a full wake-up.
+
+	Depends on FOR_INTEL & co.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+	#include <sched.h>
+	#include <pthread.h>
+#endif
+
+#include "inline.h"
+
+// Number of pause iterations before a waiting thread parks; only if there's a CPU per worker, otherwise spinning
+// just takes time away from workers that are still busy.
+#ifndef WORKER_SPIN_COUNT
+	#define WORKER_SPIN_COUNT 1024*2
+#endif
+
+BOGGLE_INLINE_FORCE static void CpuRelax()
+{
+#if defined(FOR_INTEL)
+	_mm_pause();
+#elif defined(FOR_ARM)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+// CPUs this process may run on (respects affinity masks, and thereby cpusets); falls back to 0..N-1.
+static std::vector<unsigned> GetAvailableCPUs()
+{
+	std::vector<unsigned> CPUs;
+
+#if defined(__linux__)
+	cpu_set_t set;
+	if (0 == sched_getaffinity(0, sizeof(set), &set))
+	{
+		for (unsigned iCPU = 0; iCPU < CPU_SETSIZE; ++iCPU)
+			if (CPU_ISSET(iCPU, &set))
+				CPUs.push_back(iCPU);
+	}
+#elif defined(_WIN32)
+	DWORD_PTR processMask, systemMask;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+	{
+		for (unsigned iCPU = 0; iCPU < sizeof(DWORD_PTR)*8; ++iCPU)
+			if (processMask & (DWORD_PTR(1) << iCPU))
+				CPUs.push_back(iCPU);
+	}
+#endif
+
+	if (true == CPUs.empty())
+	{
+		const unsigned numCPUs = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned iCPU = 0; iCPU < numCPUs; ++iCPU)
+			CPUs.push_back(iCPU);
+	}
+
+	return CPUs;
+}
+
+class WorkerPool
+{
+public:
+	typedef void (*Job)(void* context, unsigned iWorker);
+
+	explicit WorkerPool(size_t numWorkers) :
+		m_numWorkers(numWorkers)
+	{
+		const std::vector<unsigned> CPUs = GetAvailableCPUs();
+		m_spinCount = (numWorkers <= CPUs.size()) ? WORKER_SPIN_COUNT : 0;
+
+		m_threads.reserve(numWorkers);
+		for (unsigned iWorker = 0; iWorker < numWorkers; ++iWorker)
+			m_threads.emplace_back(&WorkerPool::WorkerLoop, this, iWorker, CPUs[iWorker % CPUs.size()]);
+	}
+
+	~WorkerPool()
+	{
+		Dispatch(nullptr, nullptr);
+
+		for (auto& thread : m_threads)
+			thread.join();
+	}
+
+	// Runs job(context, iWorker) on every worker and returns once they're all done; one job at a time.
+	void Run(Job job, void* context)
+	{
+		std::lock_guard<std::mutex> runLock(m_runMutex);
+
+		m_pending.store(unsigned(m_numWorkers), std::memory_order_relaxed);
+		Dispatch(job, context);
+
+		// Spin, then park.
+		for (unsigned iSpin = 0; iSpin < m_spinCount; ++iSpin)
+		{
+			if (0 == m_pending.load(std::memory_order_acquire))
+				return;
+
+			CpuRelax();
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_doneCondition.wait(lock, [this] { return 0 == m_pending.load(std::memory_order_acquire); });
+	}
+
+	size_t GetNumWorkers() const
+	{
+		return m_numWorkers;
+	}
+
+private:
+	// A null job tells the workers to quit.
+	void Dispatch(Job job, void* context)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_job = job;
+			m_context = context;
+			m_generation.fetch_add(1, std::memory_order_release);
+		}
+
+		m_wakeCondition.notify_all();
+	}
+
+	void WorkerLoop(unsigned iWorker, unsigned iCPU)
+	{
+		Pin(iCPU);
+
+		uint32_t generation = 0;
+		for (;;)
+		{
+			// Spin, then park.
+			unsigned iSpin = 0;
+			while (generation == m_generation.load(std::memory_order_acquire) && iSpin < m_spinCount)
+			{
+				CpuRelax();
+				++iSpin;
+			}
+
+			if (generation == m_generation.load(std::memory_order_acquire))
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wakeCondition.wait(lock, [this, generation] { return generation != m_generation.load(std::memory_order_acquire); });
+			}
+
+			// Safe to read without the lock: nothing is dispatched until all workers are done with this one.
+			generation = m_generation.load(std::memory_order_acquire);
+			const Job job = m_job;
+			void* context = m_context;
+
+			if (nullptr == job)
+				return;
+
+			job(context, iWorker);
+
+			if (1 == m_pending.fetch_sub(1, std::memory_order_acq_rel))
+			{
+				// Last one out: the lock makes sure Run() is either still spinning or already waiting.
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_doneCondition.notify_one();
+			}
+		}
+	}
+
+	// Failure is harmless (e.g. more workers than CPUs or no API for it), we'll just float.
+	static void Pin(unsigned iCPU)
+	{
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(iCPU, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+		SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << iCPU);
+#endif
+	}
+
+	const size_t m_numWorkers;
+	unsigned m_spinCount;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_runMutex;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+
+	std::atomic<uint32_t> m_generation = 0;
+	std::atomic<unsigned> m_pending = 0;
+	Job m_job = nullptr;
+	void* m_context = nullptr;
+};